@@ -0,0 +1,113 @@
+// Copyright (C) 2025 Vincent Hamp
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/// Read firmware archives
+///
+/// \file   archive.cpp
+/// \author Vincent Hamp
+/// \date   19/10/2026
+
+#include "archive.hpp"
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QtEndian>
+#include <algorithm>
+#include <quazip.h>
+#include <quazipfile.h>
+#include "trace.hpp"
+
+/// Read archive and gather binaries
+///
+/// Only `flasher_args.json` gets inflated. The binaries listed there are only
+/// looked up in the central directory of the archive and are read on demand
+/// later, see BinSource. The binaries are returned sorted by offset.
+///
+/// \param  ar_path Zip archive path
+/// \return Binaries or empty vector on error
+QVector<BinSource> read_archive(QString ar_path) {
+  ScopedTrace const trace{"read_archive"};
+  QuaZip zip{ar_path};
+  if (!zip.open(QuaZip::mdUnzip)) {
+    qCritical().noquote() << "Can't open" << QFileInfo{ar_path}.fileName();
+    return {};
+  }
+
+  // Locate flasher_args.json
+  auto const infos{zip.getFileInfoList64()};
+  auto const json_it{std::find_if(
+    infos.cbegin(), infos.cend(), [](QuaZipFileInfo64 const& info) {
+      return QFileInfo{info.name}.fileName() == "flasher_args.json";
+    })};
+  if (json_it == infos.cend()) {
+    qCritical() << "No OpenRemise firmware found";
+    return {};
+  }
+  zip.setCurrentFile(json_it->name);
+  QuaZipFile json{&zip};
+  json.open(QIODevice::ReadOnly);
+  QJsonDocument const doc{QJsonDocument::fromJson(json.readAll())};
+  json.close();
+
+  // Gather offsets, sizes and checksums of entries
+  QVector<BinSource> bins{};
+  auto const dir{QFileInfo{json_it->name}.path()};
+  QJsonObject const flash_files{doc["flash_files"].toObject()};
+  for (auto const& offset : flash_files.keys()) {
+    auto const bin_name{
+      QDir::cleanPath(dir + "/" + flash_files.value(offset).toString())};
+    auto const it{std::find_if(
+      infos.cbegin(), infos.cend(), [&bin_name](QuaZipFileInfo64 const& info) {
+        return info.name == bin_name;
+      })};
+    if (it == infos.cend() || !it->uncompressedSize) {
+      qCritical().noquote() << "Can't inflate" << bin_name;
+      return {};
+    }
+    bins.push_back({ar_path,
+                    bin_name,
+                    offset.toUInt(nullptr, 0),
+                    static_cast<uint32_t>(it->uncompressedSize),
+                    it->crc});
+  }
+
+  std::sort(
+    bins.begin(), bins.end(), [](BinSource const& a, BinSource const& b) {
+      return a.offset() < b.offset();
+    });
+  return bins;
+}
+
+/// Get firmware version from application description
+///
+/// Application images start with an image header followed by the first segment
+/// header. The first segment contains the
+/// [application description](https://docs.espressif.com/projects/esp-idf/en/latest/esp32s3/api-reference/system/misc_system_api.html#app-version)
+/// which holds the version string.
+///
+/// \param  bins  Binaries
+/// \return Firmware version or empty string if no application was found
+QString firmware_version(QVector<BinSource> const& bins) {
+  for (auto const& bin : bins)
+    if (auto const header{bin.read(0u, 0x50u)};
+        header && header->size() == 0x50 && header->front() == '\xE9' &&
+        qFromLittleEndian<uint32_t>(header->constData() + 0x20) ==
+          0xABCD5432u)
+      return QString::fromLatin1(header->constData() + 0x30,
+                                 qstrnlen(header->constData() + 0x30, 32u));
+  return {};
+}
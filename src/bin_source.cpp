@@ -0,0 +1,265 @@
+// Copyright (C) 2025 Vincent Hamp
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/// Binaries read on demand
+///
+/// \file   bin_source.cpp
+/// \author Vincent Hamp
+/// \date   19/10/2026
+
+#include "bin_source.hpp"
+#include <QBuffer>
+#include <QDebug>
+#include <QFileInfo>
+#include <QSemaphore>
+#include <QThreadPool>
+#include <algorithm>
+#include <utility>
+#include <vector>
+#include <quazipfile.h>
+
+namespace {
+
+/// Block size used when skipping or hashing
+inline constexpr qint64 block_size{64 * 1024};
+
+/// Number of chunks read ahead
+inline constexpr qsizetype window{4};
+
+} // namespace
+
+/// Ctor
+///
+/// \param  ar_path Zip archive path
+/// \param  name    Name of entry in archive
+/// \param  offset  Flash offset
+/// \param  size    Uncompressed size of entry
+/// \param  crc     CRC-32 of entry
+BinSource::BinSource(
+  QString ar_path, QString name, uint32_t offset, uint32_t size, uint32_t crc)
+  : _ar_path{ar_path}, _name{name}, _offset{offset}, _size{size}, _crc{crc} {}
+
+/// Ctor
+///
+/// \param  bin Binary held in memory
+BinSource::BinSource(Bin const& bin)
+  : _name{QString{"0x%1"}.arg(bin.offset, 8, 16, QChar{'0'})},
+    _offset{static_cast<uint32_t>(bin.offset)},
+    _size{static_cast<uint32_t>(bin.bytes.size())},
+    _bytes{bin.bytes} {}
+
+/// Get flash offset
+///
+/// \return Flash offset
+uint32_t BinSource::offset() const { return _offset; }
+
+/// Get size
+///
+/// \return Size in bytes
+uint32_t BinSource::size() const { return _size; }
+
+/// Open binary for reading
+///
+/// Archive entries can only be read sequentially, so everything in front of
+/// the position gets inflated and skipped.
+///
+/// \param  pos     Position to start reading at
+/// \return Device  Device positioned at pos
+/// \return nullptr Error
+std::unique_ptr<QIODevice> BinSource::open(uint32_t pos) const {
+  if (_ar_path.isEmpty()) {
+    auto buffer{std::make_unique<QBuffer>()};
+    buffer->setData(_bytes);
+    buffer->open(QIODevice::ReadOnly);
+    buffer->seek(pos);
+    return buffer;
+  }
+
+  auto file{std::make_unique<QuaZipFile>(_ar_path, _name)};
+  QuaZipFileInfo64 info;
+  if (!file->open(QIODevice::ReadOnly) || !file->getFileInfo(&info)) {
+    qCritical().noquote() << "Can't inflate" << _name;
+    return nullptr;
+  } else if (info.crc != _crc || info.uncompressedSize != _size) {
+    qCritical().noquote() << QFileInfo{_ar_path}.fileName()
+                          << "changed since it was opened";
+    return nullptr;
+  }
+  for (qint64 skipped{}; skipped < pos;) {
+    auto const n{file->skip(std::min<qint64>(block_size, pos - skipped))};
+    if (n <= 0) {
+      qCritical().noquote() << "Can't inflate" << _name;
+      return nullptr;
+    }
+    skipped += n;
+  }
+  return file;
+}
+
+/// Read part of binary
+///
+/// \param  pos           Position
+/// \param  size          Size in bytes
+/// \return Bytes         Bytes read, less if the binary ends before
+/// \return std::nullopt  Error
+std::optional<QByteArray> BinSource::read(uint32_t pos, uint32_t size) const {
+  size = std::min(size, _size - std::min(pos, _size));
+  auto const file{open(pos)};
+  if (!file) return std::nullopt;
+  auto bytes{file->read(size)};
+  if (bytes.size() != static_cast<qsizetype>(size)) {
+    qCritical().noquote() << "Can't inflate" << _name;
+    return std::nullopt;
+  }
+  return bytes;
+}
+
+/// Add part of binary to hash
+///
+/// \param  hash    Hash
+/// \param  pos     Position
+/// \param  size    Size in bytes
+/// \retval true    Added to hash
+/// \retval false   Error
+bool BinSource::hash(QCryptographicHash& hash,
+                     uint32_t pos,
+                     uint32_t size) const {
+  auto const file{open(pos)};
+  if (!file) return false;
+  for (qint64 added{}; added < size;) {
+    auto const bytes{file->read(std::min<qint64>(block_size, size - added))};
+    if (bytes.isEmpty()) {
+      qCritical().noquote() << "Can't inflate" << _name;
+      return false;
+    }
+    hash.addData(bytes);
+    added += bytes.size();
+  }
+  return true;
+}
+
+/// Read whole binary into memory
+///
+/// \return Bin           Binary
+/// \return std::nullopt  Error
+std::optional<Bin> BinSource::materialize() const {
+  auto const bytes{read(0u, _size)};
+  if (!bytes) return std::nullopt;
+  return Bin{.offset = _offset, .bytes = *bytes};
+}
+
+/// Read binaries into memory
+///
+/// Each binary gets inflated by a task of the global thread pool, the order of
+/// the binaries is kept.
+///
+/// \param  bins          Binaries
+/// \return Binaries      Binaries in memory
+/// \return std::nullopt  Error
+std::optional<QVector<Bin>> materialize(QVector<BinSource> const& bins) {
+  std::vector<std::optional<Bin>> materialized(bins.size());
+  QSemaphore done;
+  for (size_t i{}; i < materialized.size(); ++i)
+    QThreadPool::globalInstance()->start([&bins, &materialized, &done, i] {
+      materialized[i] = bins[static_cast<qsizetype>(i)].materialize();
+      done.release();
+    });
+  done.acquire(static_cast<int>(materialized.size()));
+
+  QVector<Bin> retval;
+  retval.reserve(bins.size());
+  for (auto& bin : materialized)
+    if (bin) retval.push_back(*std::move(bin));
+    else return std::nullopt;
+  return retval;
+}
+
+/// Insert binary sorted by offset, replacing any binary at the same offset
+///
+/// \param  bins  Binaries sorted by offset
+/// \param  bin   Binary
+void replace(QVector<BinSource>& bins, BinSource bin) {
+  auto const offset{bin.offset()};
+  bins.removeIf([offset](BinSource const& b) { return b.offset() == offset; });
+  bins.insert(std::upper_bound(bins.cbegin(),
+                               bins.cend(),
+                               offset,
+                               [](uint32_t offset, BinSource const& b) {
+                                 return offset < b.offset();
+                               }),
+              std::move(bin));
+}
+
+/// Start reading ahead
+///
+/// \param  source  Binary
+/// \param  pos     Position to start reading at
+BinReader::BinReader(BinSource source, uint32_t pos)
+  : _source{source}, _pos{pos}, _thread{QThread::create([this] { run(); })} {
+  _thread->start();
+}
+
+/// Stop reading ahead
+BinReader::~BinReader() {
+  {
+    QMutexLocker lock{&_mutex};
+    _quit = true;
+    _cond.wakeAll();
+  }
+  _thread->wait();
+}
+
+/// Get next chunk
+///
+/// \return Chunk         Next chunk, without any bytes once the end is reached
+/// \return std::nullopt  Error
+std::optional<BinReader::Chunk> BinReader::next() {
+  QMutexLocker lock{&_mutex};
+  while (_chunks.isEmpty() && !_done && !_error) _cond.wait(&_mutex);
+  if (!_chunks.isEmpty()) {
+    auto chunk{_chunks.takeFirst()};
+    _cond.wakeAll();
+    return chunk;
+  } else if (_error) return std::nullopt;
+  return Chunk{.pos = _source.size()};
+}
+
+/// Inflate and compress chunks until the window is full
+void BinReader::run() {
+  auto const file{_source.open(_pos)};
+  for (auto pos{_pos}; pos < _source.size();) {
+    Chunk chunk{.pos = pos};
+    auto const size{std::min(chunk_size, _source.size() - pos)};
+    if (file) chunk.bytes = file->read(size);
+    if (chunk.bytes.size() != static_cast<qsizetype>(size)) {
+      QMutexLocker lock{&_mutex};
+      _error = true;
+      _cond.wakeAll();
+      return;
+    }
+    // Strip the 4 byte length header Qt puts in front of the zlib stream
+    chunk.deflated = qCompress(chunk.bytes, 9).mid(4);
+    pos += size;
+
+    QMutexLocker lock{&_mutex};
+    while (_chunks.size() >= window && !_quit) _cond.wait(&_mutex);
+    if (_quit) return;
+    _chunks.push_back(std::move(chunk));
+    _cond.wakeAll();
+  }
+  QMutexLocker lock{&_mutex};
+  _done = true;
+  _cond.wakeAll();
+}
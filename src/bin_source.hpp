@@ -0,0 +1,115 @@
+// Copyright (C) 2025 Vincent Hamp
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/// Binaries read on demand
+///
+/// \file   bin_source.hpp
+/// \author Vincent Hamp
+/// \date   19/10/2026
+
+#pragma once
+
+#include <QByteArray>
+#include <QCryptographicHash>
+#include <QIODevice>
+#include <QList>
+#include <QMutex>
+#include <QString>
+#include <QThread>
+#include <QVector>
+#include <QWaitCondition>
+#include <memory>
+#include <optional>
+#include <esp_flasher/esp_flasher.hpp>
+
+/// Binary which is read from its archive on demand
+///
+/// BinSource only knows where a binary goes and how large it is. Its contents
+/// stay in the archive until they are needed and then get inflated chunk by
+/// chunk, so that even large file system images never sit in memory as a
+/// whole. The CRC-32 of the archive entry is checked each time it gets opened,
+/// which catches archives replaced in the meantime.
+///
+/// Binaries which don't come from an archive, e.g. generated NVS partition
+/// images, are held in memory instead.
+class BinSource {
+public:
+  BinSource() = default;
+  BinSource(QString ar_path,
+            QString name,
+            uint32_t offset,
+            uint32_t size,
+            uint32_t crc);
+  explicit BinSource(Bin const& bin);
+
+  uint32_t offset() const;
+  uint32_t size() const;
+  std::unique_ptr<QIODevice> open(uint32_t pos = 0u) const;
+  std::optional<QByteArray> read(uint32_t pos, uint32_t size) const;
+  bool hash(QCryptographicHash& hash, uint32_t pos, uint32_t size) const;
+  std::optional<Bin> materialize() const;
+
+private:
+  QString _ar_path{};
+  QString _name{};
+  uint32_t _offset{};
+  uint32_t _size{};
+  uint32_t _crc{};
+  QByteArray _bytes{};
+};
+
+std::optional<QVector<Bin>> materialize(QVector<BinSource> const& bins);
+void replace(QVector<BinSource>& bins, BinSource bin);
+
+/// Reads a binary chunk by chunk ahead of its consumer
+///
+/// BinReader inflates and compresses chunks of a BinSource on a thread of its
+/// own. Only a small window of chunks is read ahead, once it's full the thread
+/// waits for the consumer to catch up. This keeps the link busy while memory
+/// usage stays at a few chunks, no matter how large the binary is.
+class BinReader {
+public:
+  /// Chunk along with its zlib stream
+  struct Chunk {
+    uint32_t pos{};
+    QByteArray bytes{};
+    QByteArray deflated{};
+  };
+
+  /// Chunk size, a multiple of the flash sector size
+  static constexpr uint32_t chunk_size{0x40000u};
+
+  explicit BinReader(BinSource source, uint32_t pos = 0u);
+  ~BinReader();
+  BinReader(BinReader const&) = delete;
+  BinReader(BinReader&&) = delete;
+  BinReader& operator=(BinReader const&) = delete;
+  BinReader& operator=(BinReader&&) = delete;
+
+  std::optional<Chunk> next();
+
+private:
+  void run();
+
+  BinSource const _source{};
+  uint32_t const _pos{};
+  QMutex _mutex{};
+  QWaitCondition _cond{};
+  QList<Chunk> _chunks{};
+  std::unique_ptr<QThread> _thread{};
+  bool _done{};
+  bool _error{};
+  bool _quit{};
+};
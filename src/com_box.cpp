@@ -20,21 +20,33 @@
 /// \date   05/11/2024
 
 #include "com_box.hpp"
+#include <QElapsedTimer>
+#include <QFileDialog>
 #include <QHBoxLayout>
 #include <QLabel>
 #include <QSerialPortInfo>
+#include <QThreadPool>
+#include <QVBoxLayout>
+#include <atomic>
+#include <memory>
+#include <numeric>
+#include <utility>
+#include "archive.hpp"
 #include "boards.hpp"
+#include "cost_model.hpp"
+#include "message_handler.hpp"
+#include "metrics.hpp"
+#include "production_log.hpp"
+#include "provisioning.hpp"
+#include "trace.hpp"
+#include "transport.hpp"
 #include "update_ports_event_filter.hpp"
 
 /// Create layout of various dropdown menus and a start/stop button
 ComBox::ComBox(QWidget* parent) : QGroupBox{parent} {
-  // Start/stop button
-  QPixmap pixmap_off{":/light/play.svg"};
-  QPixmap pixmap_on{":/light/stop.svg"};
-  QIcon ico;
-  ico.addPixmap(pixmap_off, QIcon::Normal, QIcon::Off);
-  ico.addPixmap(pixmap_on, QIcon::Normal, QIcon::On);
-  _start_stop_button->setIcon(ico);
+  ScopedTrace const trace{"ComBox::ComBox"};
+
+  // Start/stop button, icons are loaded later
   _start_stop_button->setText("Start");
   _start_stop_button->setCheckable(true);
 
@@ -51,7 +63,11 @@ ComBox::ComBox(QWidget* parent) : QGroupBox{parent} {
   // Install an event filter which updates list of serial ports every time the
   // dropdown is selected
   _port_combobox->installEventFilter(new UpdatePortsEventFilter{this});
-  _port_combobox->setToolTip("Serial port device");
+  // Network ports can be typed in
+  _port_combobox->setEditable(true);
+  _port_combobox->setInsertPolicy(QComboBox::NoInsert);
+  _port_combobox->setToolTip(
+    "Serial port device, tcp://host:port or rfc2217://host:port");
 
   // Baud dropdown
   _baud_combobox->setSizeAdjustPolicy(QComboBox::AdjustToContents);
@@ -62,18 +78,60 @@ ComBox::ComBox(QWidget* parent) : QGroupBox{parent} {
   _baud_combobox->setToolTip(
     "Serial port baud rate used when flashing/reading");
 
+  // Dry run checkbox
+  _dry_run_checkbox->setToolTip(
+    "Only predict how long writing takes with the current options");
+
+  // Pipeline checkbox
+  _pipeline_checkbox->setToolTip(
+    "Use built-in loader which sends the next block while the target is "
+    "still writing");
+
+  // Stub checkbox, only available with pipeline
+  _stub_checkbox->setEnabled(false);
+  _stub_checkbox->setToolTip(
+    "Upload flasher stub to RAM first, allows larger blocks and higher baud "
+    "rates");
+  connect(_pipeline_checkbox,
+          &QCheckBox::toggled,
+          _stub_checkbox,
+          &QCheckBox::setEnabled);
+
+  // Backup checkbox and range dropdown, only available with stub
+  _backup_checkbox->setToolTip("Save flash contents to a file before writing");
+  _range_combobox->setSizeAdjustPolicy(QComboBox::AdjustToContents);
+  _range_combobox->setEditable(true);
+  _range_combobox->addItem("all");
+  _range_combobox->setToolTip(
+    "Flash range to save, either \"all\" or <offset>:<size> (e.g. "
+    "0x9000:0x6000)");
+  for (auto checkbox : {_pipeline_checkbox, _stub_checkbox, _backup_checkbox})
+    connect(
+      checkbox, &QCheckBox::toggled, this, &ComBox::updateBackupOptions);
+  updateBackupOptions();
+
   // Layout
-  auto layout{new QHBoxLayout};
+  auto port_layout{new QHBoxLayout};
+  port_layout->addWidget(_start_stop_button);
+  port_layout->addWidget(new QLabel{"Board"}, 0, Qt::AlignRight);
+  port_layout->addWidget(_board_combobox);
+  port_layout->addWidget(new QLabel{"Com"}, 0, Qt::AlignRight);
+  port_layout->addWidget(_port_combobox);
+  port_layout->addWidget(new QLabel{"Baud"}, 0, Qt::AlignRight);
+  port_layout->addWidget(_baud_combobox);
+  auto options_layout{new QHBoxLayout};
+  options_layout->addStretch();
+  options_layout->addWidget(_dry_run_checkbox);
+  options_layout->addWidget(_pipeline_checkbox);
+  options_layout->addWidget(_stub_checkbox);
+  options_layout->addWidget(_backup_checkbox);
+  options_layout->addWidget(_range_combobox);
+  auto layout{new QVBoxLayout};
   // Workaround: top margin must be zero for the layout to be vertically
   // centered
   layout->setContentsMargins(11, 0, 11, 11);
-  layout->addWidget(_start_stop_button);
-  layout->addWidget(new QLabel{"Board"}, 0, Qt::AlignRight);
-  layout->addWidget(_board_combobox);
-  layout->addWidget(new QLabel{"Com"}, 0, Qt::AlignRight);
-  layout->addWidget(_port_combobox);
-  layout->addWidget(new QLabel{"Baud"}, 0, Qt::AlignRight);
-  layout->addWidget(_baud_combobox);
+  layout->addLayout(port_layout);
+  layout->addLayout(options_layout);
   setLayout(layout);
 
   connect(_start_stop_button,
@@ -82,10 +140,27 @@ ComBox::ComBox(QWidget* parent) : QGroupBox{parent} {
           &ComBox::startStopButtonClicked);
 }
 
+/// Stop LoaderWorker
+ComBox::~ComBox() {
+  stopLoaderWorker();
+  for (auto const& thread : _stopping_loader_threads)
+    if (thread) thread->wait();
+}
+
+/// Load icons of start/stop button
+void ComBox::loadIcons() {
+  QPixmap pixmap_off{":/light/play.svg"};
+  QPixmap pixmap_on{":/light/stop.svg"};
+  QIcon ico;
+  ico.addPixmap(pixmap_off, QIcon::Normal, QIcon::Off);
+  ico.addPixmap(pixmap_on, QIcon::Normal, QIcon::On);
+  _start_stop_button->setIcon(ico);
+}
+
 /// Set binaries slot
 ///
 /// \param  bins  Binaries
-void ComBox::binaries(QVector<Bin> bins) { _bins = bins; }
+void ComBox::binaries(QVector<BinSource> bins) { _bins = bins; }
 
 /// Start/stop button slot
 ///
@@ -93,41 +168,305 @@ void ComBox::binaries(QVector<Bin> bins) { _bins = bins; }
 void ComBox::startStopButtonClicked(bool start) {
   // Start thread
   if (start) {
-    _start_stop_button->setText("Stop");
+    // Predict instead of writing
+    if (_dry_run_checkbox->isChecked()) {
+      _start_stop_button->setChecked(false);
+      dryRun(_bins);
+      return;
+    }
+
+    // Backup requires a file name, cancel if none is chosen
+    std::optional<LoaderWorker::Backup> backup;
+    if (_backup_checkbox->isEnabled() && _backup_checkbox->isChecked() &&
+        !(backup = backupOptions())) {
+      _start_stop_button->setChecked(false);
+      return;
+    }
 
     QString const port{_port_combobox->currentText()};
     QString const baud{_baud_combobox->currentText()};
 
+    // EspFlasher only knows local serial ports, LoaderWorker takes the
+    // per-board image itself once it knows the board needs writing
+    if (_pipeline_checkbox->isChecked() || Transport::isNetwork(port)) {
+      _start_stop_button->setText("Stop");
+      loaderWorker(port)->start({.baud = baud,
+                                 .stub = _stub_checkbox->isChecked(),
+                                 .bins = _bins,
+                                 .backup = backup,
+                                 .provision = Provisioning::get()->isOpen()});
+      return;
+    }
+
+    // Per-board image, replaces any binary at the same offset
+    auto bins{_bins};
+    if (Provisioning::get()->isOpen()) {
+      auto const bin{Provisioning::get()->next(_bins)};
+      if (!bin) {
+        _start_stop_button->setChecked(false);
+        return;
+      }
+      replace(bins, BinSource{*bin});
+    }
+
+    _start_stop_button->setText("Stop");
+
     _thread = new QThread;
-    _esp_flasher = new EspFlasher{
-      "esp32s3", port, baud, "no_reset", "no_reset", "", "", _bins};
-    _esp_flasher->moveToThread(_thread);
 
-    // Thread starts loader
+    // Time between clicking and the thread actually running
+    QElapsedTimer queued;
+    queued.start();
+    connect(_thread, &QThread::started, [queued] {
+      Metrics::get()->queued(queued.elapsed() / 1000.0);
+    });
+
+    // Context of production log records
     connect(_thread,
             &QThread::started,
-            _esp_flasher,
-            qOverload<>(&EspFlasher::flash));
+            [context = ProductionLog::Context{
+               .port = port, .firmware = firmware_version(bins)}] {
+              ProductionLog::setContext(context);
+            });
 
-    // When loader finishes, quit thread and delete loader
-    connect(_esp_flasher, &EspFlasher::finished, _thread, &QThread::quit);
-    connect(_esp_flasher,
-            &EspFlasher::finished,
-            _esp_flasher,
-            &EspFlasher::deleteLater);
+    // EspFlasher needs all binaries in memory, they get read on its thread
+    // and inflated concurrently
+    connect(_thread, &QThread::started, [port, baud, bins] {
+      QElapsedTimer timer;
+      timer.start();
+      std::optional<QVector<Bin>> materialized;
+      {
+        ScopedTrace const trace{"ComBox::materialize"};
+        materialized = materialize(bins);
+      }
+      auto const thread{QThread::currentThread()};
+      if (thread->isInterruptionRequested()) {
+        ProductionLog::get()->result("interrupted");
+        thread->quit();
+      } else if (!materialized) {
+        ProductionLog::get()->result("failure");
+        Metrics::get()->failed(Metrics::Phase::Flash);
+        thread->quit();
+      } else
+        startWorker(new EspFlasher{"esp32s3",
+                                   port,
+                                   baud,
+                                   "no_reset",
+                                   "no_reset",
+                                   "",
+                                   "",
+                                   *std::move(materialized)},
+                    std::accumulate(bins.cbegin(),
+                                    bins.cend(),
+                                    qsizetype{},
+                                    [](qsizetype size, BinSource const& bin) {
+                                      return size + bin.size();
+                                    }),
+                    timer);
+    });
 
     // When thread finished, delete thread
     connect(_thread, &QThread::finished, _thread, &QThread::deleteLater);
 
     // Once thread is destroyed, reset button
     connect(_thread, &QThread::destroyed, [this] {
-      _start_stop_button->setChecked(false);
-      _start_stop_button->setText("Start");
+      _thread = nullptr;
+      resetStartStopButton();
     });
 
     _thread->start();
   }
   // Stop running thread
-  else if (_thread->isRunning())
-    _thread->requestInterruption();
+  else if (_thread) _thread->requestInterruption();
+  // Stop running job
+  else if (_loader_worker) _loader_worker->cancel();
+}
+
+/// Enable backup options only while the stub is enabled
+void ComBox::updateBackupOptions() {
+  _backup_checkbox->setEnabled(_stub_checkbox->isEnabled() &&
+                               _stub_checkbox->isChecked());
+  _range_combobox->setEnabled(_backup_checkbox->isEnabled() &&
+                              _backup_checkbox->isChecked());
+}
+
+/// Get range to backup and ask for a file to save it to
+///
+/// \return Backup        Range and file
+/// \return std::nullopt  Invalid range or no file chosen
+std::optional<LoaderWorker::Backup> ComBox::backupOptions() {
+  LoaderWorker::Backup backup;
+
+  // Range is either "all" or <offset>:<size>, both decimal or 0x prefixed
+  if (auto const range{_range_combobox->currentText().trimmed()};
+      range != "all") {
+    auto const parts{range.split(':')};
+    auto offset_ok{false};
+    auto size_ok{false};
+    if (parts.size() == 2) {
+      backup.offset = parts[0].trimmed().toUInt(&offset_ok, 0);
+      backup.size = parts[1].trimmed().toUInt(&size_ok, 0);
+    }
+    if (!offset_ok || !size_ok || !backup.size) {
+      qCritical().noquote() << "Invalid backup range" << range;
+      return std::nullopt;
+    }
+  }
+
+  backup.path = QFileDialog::getSaveFileName(
+    this,
+    "Save backup",
+    "backup.bin",
+    "Binary (*.bin);;Compressed binary (*.bin.gz)",
+    nullptr,
+    QFileDialog::DontUseCustomDirectoryIcons);
+  if (backup.path.isEmpty()) return std::nullopt;
+  return backup;
+}
+
+/// Log predicted timeline of writing binaries with the current options
+///
+/// \param  bins  Binaries
+void ComBox::dryRun(QVector<BinSource> bins) {
+  auto const pipeline{_pipeline_checkbox->isChecked()};
+  auto const stub{pipeline && _stub_checkbox->isChecked()};
+  auto const baud{_baud_combobox->currentText()};
+  CostModel::Link const link{.baud_rate = baud != "auto" ? baud.toInt()
+                                          : stub         ? 921600
+                                          : pipeline     ? 460800
+                                                         : 115200,
+                             .stub = stub};
+
+  // Compressing takes a while
+  QThreadPool::globalInstance()->start([bins, link] {
+    for (auto const& line : CostModel::get()->timeline(bins, link))
+      qInfo().noquote() << line;
+  });
+}
+
+/// Start worker created on its thread
+///
+/// Called from the thread of the worker.
+///
+/// \param  worker  Worker
+/// \param  bytes   Bytes written by worker, including provisioned images
+/// \param  timer   Timer started along with the thread
+void ComBox::startWorker(EspFlasher* worker,
+                         qsizetype bytes,
+                         QElapsedTimer timer) {
+  auto const thread{QThread::currentThread()};
+
+  // EspFlasher doesn't report whether it succeeded, so count critical messages
+  // logged from its thread instead
+  auto const failed{std::make_shared<std::atomic<bool>>()};
+  connect(
+    MessageHandler::get(),
+    &MessageHandler::messageHandler,
+    worker,
+    [failed, thread](QtMsgType type) {
+      if (type == QtCriticalMsg && QThread::currentThread() == thread)
+        *failed = true;
+    },
+    Qt::DirectConnection);
+  connect(worker, &EspFlasher::finished, [failed, timer, bytes, thread] {
+    if (thread->isInterruptionRequested())
+      ProductionLog::get()->result("interrupted");
+    else if (*failed) {
+      ProductionLog::get()->result("failure");
+      Metrics::get()->failed(Metrics::Phase::Flash);
+    } else {
+      ProductionLog::get()->result("success");
+      Metrics::get()->flashed(bytes, timer.elapsed() / 1000.0);
+    }
+  });
+
+  // When worker finishes, quit thread and delete worker
+  connect(worker, &EspFlasher::finished, thread, &QThread::quit);
+  connect(worker, &EspFlasher::finished, worker, &EspFlasher::deleteLater);
+
+  // Event loop of thread starts worker
+  QMetaObject::invokeMethod(
+    worker, [worker] { worker->flash(); }, Qt::QueuedConnection);
+}
+
+/// Get LoaderWorker of port
+///
+/// The worker of any other port gets stopped first, which closes its
+/// connection once its job returned. Jobs of the new worker are queued until
+/// then.
+///
+/// \param  port  Serial port name, network address or "auto"
+/// \return LoaderWorker of port
+LoaderWorker* ComBox::loaderWorker(QString port) {
+  if (_loader_worker && _loader_worker->port() == port) return _loader_worker;
+  stopLoaderWorker();
+
+  _loader_thread = new QThread;
+  _loader_worker = new LoaderWorker{port};
+  _loader_worker->moveToThread(_loader_thread);
+
+  // Once a job is done, reset button
+  connect(_loader_worker,
+          &LoaderWorker::finished,
+          this,
+          &ComBox::resetStartStopButton);
+
+  // When thread finished, delete worker (on its own thread) and thread
+  connect(_loader_thread,
+          &QThread::finished,
+          _loader_worker,
+          &LoaderWorker::deleteLater);
+  connect(
+    _loader_thread, &QThread::finished, _loader_thread, &QThread::deleteLater);
+
+  // Worker closes its port when destroyed, which might let the next one start
+  connect(_loader_worker,
+          &QObject::destroyed,
+          this,
+          [this, thread = _loader_thread] {
+            _stopping_loader_threads.removeIf(
+              [thread](QPointer<QThread> const& t) {
+                return !t || t == thread;
+              });
+            startLoaderThread();
+          });
+
+  startLoaderThread();
+  return _loader_worker;
+}
+
+/// Stop LoaderWorker without waiting for its thread to finish
+///
+/// The running job gets cancelled, thread and worker delete themselves once it
+/// returned. Until then the thread is kept track of.
+void ComBox::stopLoaderWorker() {
+  if (!_loader_thread) return;
+  auto const thread{std::exchange(_loader_thread, nullptr)};
+  auto const worker{std::exchange(_loader_worker, nullptr)};
+
+  // Never started because another worker was still stopping
+  if (!thread->isRunning()) {
+    delete worker;
+    delete thread;
+    return;
+  }
+
+  // Button belongs to the next worker from now on
+  disconnect(
+    worker, &LoaderWorker::finished, this, &ComBox::resetStartStopButton);
+  worker->cancel();
+  thread->quit();
+  _stopping_loader_threads.push_back(thread);
+}
+
+/// Start thread of LoaderWorker once no stopped worker is left
+void ComBox::startLoaderThread() {
+  if (_loader_thread && _stopping_loader_threads.isEmpty() &&
+      !_loader_thread->isRunning() && !_loader_thread->isFinished())
+    _loader_thread->start();
+}
+
+/// Reset start/stop button once a run is done
+void ComBox::resetStartStopButton() {
+  _start_stop_button->setChecked(false);
+  _start_stop_button->setText("Start");
 }
@@ -23,10 +23,15 @@
 
 #include <QCheckBox>
 #include <QComboBox>
+#include <QElapsedTimer>
 #include <QGroupBox>
+#include <QPointer>
 #include <QPushButton>
 #include <QThread>
 #include <esp_flasher/esp_flasher.hpp>
+#include <optional>
+#include "bin_source.hpp"
+#include "loader_worker.hpp"
 
 /// Bottom part GUI widget which displays serial port options
 ///
@@ -34,24 +39,59 @@
 /// which displays a couple of dropdown menus to choose various serial port
 /// options. Apart from that, there is a start/stop button to start the writing
 /// process.
+///
+/// By default writing is done by EspFlasher. Checking the pipeline checkbox
+/// switches to LoaderWorker instead, which keeps the serial link busy while the
+/// target is writing flash. With the stub checkbox checked as well, it uploads
+/// the esptool flasher stub first. Ports on the network (tcp://host:port or
+/// rfc2217://host:port) are always written by LoaderWorker. Once the stub is
+/// enabled, the backup checkbox allows to save a flash range, or the whole
+/// chip, to a file before writing. With the dry run checkbox checked, Start
+/// only logs how long writing would take, as predicted by CostModel.
+///
+/// While EspFlasher gets a new thread for every run, there is only a single
+/// LoaderWorker which keeps running on its own thread until another port gets
+/// chosen. Its connection to the target is reused by the next run. A worker
+/// which got stopped finishes its job in the background, the thread of the
+/// next worker only starts once it's gone.
 class ComBox : public QGroupBox {
   Q_OBJECT
 
 public:
   ComBox(QWidget* parent = nullptr);
+  ~ComBox();
+
+  void loadIcons();
 
 public slots:
-  void binaries(QVector<Bin> bins);
+  void binaries(QVector<BinSource> bins);
 
 private slots:
   void startStopButtonClicked(bool start);
 
 private:
+  static void
+  startWorker(EspFlasher* worker, qsizetype bytes, QElapsedTimer timer);
+  LoaderWorker* loaderWorker(QString port);
+  void stopLoaderWorker();
+  void startLoaderThread();
+  void resetStartStopButton();
+  void updateBackupOptions();
+  std::optional<LoaderWorker::Backup> backupOptions();
+  void dryRun(QVector<BinSource> bins);
+
   QComboBox* _board_combobox{new QComboBox};
   QComboBox* _port_combobox{new QComboBox};
   QComboBox* _baud_combobox{new QComboBox};
+  QCheckBox* _dry_run_checkbox{new QCheckBox{"Dry run"}};
+  QCheckBox* _pipeline_checkbox{new QCheckBox{"Pipeline"}};
+  QCheckBox* _stub_checkbox{new QCheckBox{"Stub"}};
+  QCheckBox* _backup_checkbox{new QCheckBox{"Backup"}};
+  QComboBox* _range_combobox{new QComboBox};
   QPushButton* _start_stop_button{new QPushButton};
-  QVector<Bin> _bins{};
+  QVector<BinSource> _bins{};
   QThread* _thread{};
-  EspFlasher* _esp_flasher{};
+  QThread* _loader_thread{};
+  LoaderWorker* _loader_worker{};
+  QList<QPointer<QThread>> _stopping_loader_threads{};
 };
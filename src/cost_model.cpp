@@ -0,0 +1,256 @@
+// Copyright (C) 2025 Vincent Hamp
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/// Flash time cost model
+///
+/// \file   cost_model.cpp
+/// \author Vincent Hamp
+/// \date   19/10/2026
+
+#include "cost_model.hpp"
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <algorithm>
+#include <utility>
+
+namespace {
+
+/// Rates before anything got measured, ROM loader first
+inline constexpr std::array<CostModel::Rates, 2u> default_rates{
+  CostModel::Rates{.connect = 0.5,
+                   .erase = 250e3,
+                   .program = 300e3,
+                   .inflate = 1e6,
+                   .md5 = 1e6,
+                   .latency = 0.002},
+  CostModel::Rates{.connect = 2.0,
+                   .erase = 250e3,
+                   .program = 300e3,
+                   .inflate = 2e6,
+                   .md5 = 4e6,
+                   .latency = 0.002}};
+
+/// Names of rates in JSON file
+inline constexpr std::array rate_names{"rom", "stub"};
+inline constexpr std::array<std::pair<char const*, double CostModel::Rates::*>,
+                            8u>
+  rate_fields{{{"connect", &CostModel::Rates::connect},
+               {"erase", &CostModel::Rates::erase},
+               {"program", &CostModel::Rates::program},
+               {"inflate", &CostModel::Rates::inflate},
+               {"md5", &CostModel::Rates::md5},
+               {"latency", &CostModel::Rates::latency},
+               {"deflated", &CostModel::Rates::deflated},
+               {"raw", &CostModel::Rates::raw}}};
+
+/// Maximum size of a data packet accepted by the ROM loader and the stub
+inline constexpr uint32_t rom_block_size{0x400u};
+inline constexpr uint32_t stub_block_size{0x4000u};
+
+/// Flash sector size, erasing happens in whole sectors
+inline constexpr uint32_t sector_size{0x1000u};
+
+/// Bytes on the wire per block on top of the payload (command, data header
+/// and SLIP delimiters) and escaping overhead of random data
+inline constexpr auto frame_overhead{26.0};
+inline constexpr auto slip_overhead{1.008};
+
+/// Weight of a new measurement
+inline constexpr auto alpha{0.3};
+
+/// Measurements shorter than this are too noisy to learn from
+inline constexpr auto min_seconds{0.05};
+
+} // namespace
+
+/// Singleton pattern
+CostModel* CostModel::get() {
+  static CostModel cost_model;
+  return &cost_model;
+}
+
+/// Read rates from application data location
+CostModel::CostModel()
+  : _path{QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) +
+          "/cost_model.json"},
+    _rates{default_rates} {
+  QFile file{_path};
+  if (!file.open(QIODevice::ReadOnly)) return;
+  auto const doc{QJsonDocument::fromJson(file.readAll())};
+  for (size_t i{}; i < _rates.size(); ++i)
+    for (auto const obj{doc[rate_names[i]].toObject()};
+         auto const& [name, field] : rate_fields)
+      if (auto const value{obj[name].toDouble()}; value > 0.0)
+        _rates[i].*field = value;
+}
+
+/// Predict erase, write and verify times of a chunk
+///
+/// Link and target work in parallel, so writing takes as long as the slower
+/// of both plus a round trip per block. Compressed writes put less on the
+/// link, but the target has to inflate the data as well. Whichever is faster
+/// gets chosen.
+///
+/// \param  offset        Flash offset
+/// \param  size          Size
+/// \param  deflated_size Compressed size
+/// \param  link          Link to the target
+/// \return Predicted times
+CostModel::Step CostModel::predict(uint32_t offset,
+                                   uint32_t size,
+                                   uint32_t deflated_size,
+                                   Link link) const {
+  QMutexLocker lock{&_mutex};
+  auto const& rates{_rates[link.stub]};
+  auto const block_size{link.stub ? stub_block_size : rom_block_size};
+  auto const bytes_per_second{std::max(link.baud_rate, 9600) / 10.0};
+
+  auto const write{[&](uint32_t payload, double target) {
+    auto const blocks{(payload + block_size - 1u) / block_size};
+    auto const wire{payload * slip_overhead + blocks * frame_overhead};
+    return std::max(wire / bytes_per_second, target) + blocks * rates.latency;
+  }};
+  auto const program{size / rates.program};
+  auto const deflated{
+    write(deflated_size, program + size / rates.inflate) * rates.deflated};
+  auto const raw{write(size, program) * rates.raw};
+
+  return {.offset = offset,
+          .size = size,
+          .deflated_size = deflated_size,
+          .compressed = deflated <= raw,
+          .erase = (size + sector_size - 1u) / sector_size * sector_size /
+                   rates.erase,
+          .write = std::min(deflated, raw),
+          .verify = size / rates.md5};
+}
+
+/// Predict timeline of writing binaries
+///
+/// The binaries get read and compressed chunk by chunk, just like when
+/// writing, so this takes a while for large archives.
+///
+/// \param  bins  Binaries
+/// \param  link  Link to the target
+/// \return One line per step, each starting with the predicted time
+QStringList CostModel::timeline(QVector<BinSource> const& bins,
+                                Link link) const {
+  QStringList lines{QString{"Dry run at %1 baud%2"}.arg(link.baud_rate).arg(
+    link.stub ? " with stub" : "")};
+  double t{};
+  auto const append{[&lines, &t](double duration, QString step) {
+    lines.append(QString{"%1s %2 (%3s)"}
+                   .arg(t, 6, 'f', 1)
+                   .arg(step)
+                   .arg(duration, 0, 'f', 1));
+    t += duration;
+  }};
+
+  {
+    QMutexLocker lock{&_mutex};
+    append(_rates[link.stub].connect, "connect");
+  }
+  for (auto const& bin : bins) {
+    // Sum up the chunks of a binary
+    Step sum{.offset = bin.offset(), .size = bin.size()};
+    auto chunks{0};
+    auto compressed{0};
+    BinReader reader{bin};
+    for (;;) {
+      auto const chunk{reader.next()};
+      if (!chunk) return {};
+      else if (chunk->bytes.isEmpty()) break;
+      auto const step{predict(bin.offset() + chunk->pos,
+                              static_cast<uint32_t>(chunk->bytes.size()),
+                              static_cast<uint32_t>(chunk->deflated.size()),
+                              link)};
+      ++chunks;
+      compressed += step.compressed;
+      sum.deflated_size += step.compressed ? step.deflated_size : step.size;
+      sum.erase += step.erase;
+      sum.write += step.write;
+      sum.verify += step.verify;
+    }
+
+    auto const offset{QString{"0x%1"}.arg(sum.offset, 8, 16, QChar{'0'})};
+    append(sum.erase, QString{"erase %1, %2 bytes"}.arg(offset).arg(sum.size));
+    append(sum.write,
+           compressed == chunks
+             ? QString{"write %1, %2 bytes compressed"}.arg(offset).arg(
+                 sum.deflated_size)
+           : !compressed
+             ? QString{"write %1, %2 bytes raw"}.arg(offset).arg(sum.size)
+             : QString{"write %1, %2 bytes partly compressed"}
+                 .arg(offset)
+                 .arg(sum.deflated_size));
+    append(sum.verify, QString{"verify %1"}.arg(offset));
+  }
+  lines.append(QString{"%1s done"}.arg(t, 6, 'f', 1));
+  return lines;
+}
+
+/// Learn from a measured write
+///
+/// \param  step    Predicted times
+/// \param  link    Link to the target
+/// \param  seconds Measured time of erasing and writing
+void CostModel::observeWrite(Step const& step, Link link, double seconds) {
+  if (seconds < min_seconds || step.write <= 0.0) return;
+  QMutexLocker lock{&_mutex};
+  auto& factor{step.compressed ? _rates[link.stub].deflated
+                               : _rates[link.stub].raw};
+  auto const ratio{std::clamp((seconds - step.erase) / step.write, 0.2, 5.0)};
+  factor *= (1.0 - alpha) + alpha * ratio;
+  _dirty = true;
+}
+
+/// Learn from a measured MD5 digest
+///
+/// \param  size    Size in bytes
+/// \param  link    Link to the target
+/// \param  seconds Measured time
+void CostModel::observeVerify(uint32_t size, Link link, double seconds) {
+  if (seconds < min_seconds) return;
+  QMutexLocker lock{&_mutex};
+  auto& md5{_rates[link.stub].md5};
+  md5 = (1.0 - alpha) * md5 + alpha * size / seconds;
+  _dirty = true;
+}
+
+/// Write rates to application data location if they changed
+void CostModel::save() {
+  QJsonObject root;
+  {
+    QMutexLocker lock{&_mutex};
+    if (!std::exchange(_dirty, false)) return;
+    for (size_t i{}; i < _rates.size(); ++i) {
+      QJsonObject obj;
+      for (auto const& [name, field] : rate_fields)
+        obj[name] = _rates[i].*field;
+      root[rate_names[i]] = obj;
+    }
+  }
+  QDir{}.mkpath(QFileInfo{_path}.absolutePath());
+  QSaveFile file{_path};
+  if (!file.open(QIODevice::WriteOnly) ||
+      file.write(QJsonDocument{root}.toJson()) < 0 || !file.commit())
+    qCritical().noquote() << "Can't write" << _path;
+}
@@ -0,0 +1,105 @@
+// Copyright (C) 2025 Vincent Hamp
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/// Flash time cost model
+///
+/// \file   cost_model.hpp
+/// \author Vincent Hamp
+/// \date   19/10/2026
+
+#pragma once
+
+#include <QMutex>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <array>
+#include "bin_source.hpp"
+
+/// Predicts how long writing binaries takes
+///
+/// CostModel is a singleton which predicts erase, write and verify times of
+/// each chunk of a binary from a handful of rates, the baud rate of the link
+/// and whether the stub is running. Writing compressed data is limited by how
+/// fast the target inflates and programs flash, writing raw data by how fast
+/// the link is. For each chunk the faster one is chosen by
+/// CostModel::predict().
+///
+/// The rates are stored as JSON file in the application data location. While
+/// writing LoaderWorker reports the measured times, which slowly pull the
+/// rates towards what the station actually achieves. The file only gets
+/// written once per run by CostModel::save(). CostModel::timeline()
+/// turns the predictions into a dry run, without touching the target.
+///
+/// All calls are thread-safe.
+class CostModel {
+public:
+  /// Link to the target
+  struct Link {
+    qint32 baud_rate{};
+    bool stub{};
+  };
+
+  /// Calibrated rates of either the ROM loader or the stub
+  ///
+  /// Connecting and the round trip per block are in seconds, erasing,
+  /// programming, inflating and calculating MD5 digests in bytes per second.
+  /// Predicted write times get multiplied by a correction factor for compressed
+  /// and raw writes each.
+  struct Rates {
+    double connect{};
+    double erase{};
+    double program{};
+    double inflate{};
+    double md5{};
+    double latency{};
+    double deflated{1.0};
+    double raw{1.0};
+  };
+
+  /// Predicted times of a chunk in seconds
+  struct Step {
+    uint32_t offset{};
+    uint32_t size{};
+    uint32_t deflated_size{};
+    bool compressed{};
+    double erase{};
+    double write{};
+    double verify{};
+  };
+
+  static CostModel* get();
+
+  Step predict(uint32_t offset,
+               uint32_t size,
+               uint32_t deflated_size,
+               Link link) const;
+  QStringList timeline(QVector<BinSource> const& bins, Link link) const;
+  void observeWrite(Step const& step, Link link, double seconds);
+  void observeVerify(uint32_t size, Link link, double seconds);
+  void save();
+
+private:
+  CostModel();
+  CostModel(CostModel const&) = delete;
+  CostModel(CostModel&&) = delete;
+  CostModel& operator=(CostModel const&) = delete;
+  CostModel& operator=(CostModel&&) = delete;
+
+  QString _path{};
+  mutable QMutex _mutex{};
+  std::array<Rates, 2u> _rates{};
+  bool _dirty{};
+};
@@ -0,0 +1,36 @@
+// Copyright (C) 2025 Vincent Hamp
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/// Event filter to notice the first frame of a widget
+///
+/// \file   first_paint_event_filter.cpp
+/// \author Vincent Hamp
+/// \date   19/10/2026
+
+#include "first_paint_event_filter.hpp"
+#include <QTimer>
+
+FirstPaintEventFilter::FirstPaintEventFilter(QWidget* parent)
+  : QObject{parent} {}
+
+bool FirstPaintEventFilter::eventFilter(QObject* obj, QEvent* event) {
+  if (event->type() == QEvent::Paint) {
+    obj->removeEventFilter(this);
+    // Paint event is yet to be handled, signal once the frame is done
+    QTimer::singleShot(0, this, &FirstPaintEventFilter::painted);
+  }
+  // Standard event processing
+  return QObject::eventFilter(obj, event);
+}
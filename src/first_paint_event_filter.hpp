@@ -0,0 +1,45 @@
+// Copyright (C) 2025 Vincent Hamp
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/// Event filter to notice the first frame of a widget
+///
+/// \file   first_paint_event_filter.hpp
+/// \author Vincent Hamp
+/// \date   19/10/2026
+
+#pragma once
+
+#include <QEvent>
+#include <QWidget>
+
+/// Event filter which signals once a widget got painted the first time
+///
+/// FirstPaintEventFilter is an event filter which can be installed on a
+/// top-level widget. Once the first paint event arrives, it removes itself and
+/// emits FirstPaintEventFilter::painted() from the event loop, i.e. after the
+/// frame has been drawn. This allows deferring work which isn't needed to
+/// show the window, as well as measuring the time to the first frame.
+class FirstPaintEventFilter : public QObject {
+  Q_OBJECT
+
+public:
+  explicit FirstPaintEventFilter(QWidget* parent = nullptr);
+
+signals:
+  void painted();
+
+protected:
+  bool eventFilter(QObject* obj, QEvent* event) override;
+};
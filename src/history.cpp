@@ -0,0 +1,213 @@
+// Copyright (C) 2025 Vincent Hamp
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/// Flash history
+///
+/// \file   history.cpp
+/// \author Vincent Hamp
+/// \date   19/10/2026
+
+#include "history.hpp"
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDebug>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QSaveFile>
+#include <QtEndian>
+#include <algorithm>
+
+namespace {
+
+/// Older runs of a board get dropped
+inline constexpr qsizetype max_runs{100};
+
+/// Files with fewer lines never get compacted
+inline constexpr qsizetype min_compact_lines{1000};
+
+/// Convert run to line
+///
+/// \param  mac Board
+/// \param  run Run
+/// \return Line
+QByteArray line(QString const& mac, QJsonObject run) {
+  run["mac"] = mac;
+  return QJsonDocument{run}.toJson(QJsonDocument::Compact) + '\n';
+}
+
+} // namespace
+
+/// Singleton pattern
+History* History::get() {
+  static History history;
+  return &history;
+}
+
+/// Calculate digest of binaries
+///
+/// SHA-256 over offset, size and content of each binary. The binaries get
+/// streamed through the hash, they are never held in memory as a whole.
+///
+/// \param  bins  Binaries
+/// \return Digest
+/// \return Empty digest if a binary can't be read
+QByteArray History::digest(QVector<BinSource> const& bins) {
+  QCryptographicHash hash{QCryptographicHash::Sha256};
+  for (auto const& bin : bins) {
+    char header[8];
+    qToLittleEndian(bin.offset(), header);
+    qToLittleEndian(bin.size(), header + 4);
+    hash.addData(QByteArray{header, sizeof(header)});
+    if (!bin.hash(hash, 0u, bin.size())) return {};
+  }
+  return hash.result();
+}
+
+/// Read history
+///
+/// A line which can't be parsed, e.g. because the application got killed
+/// while appending it, is skipped.
+///
+/// \param  path    JSON lines file, created if it doesn't exist
+/// \param  trusted Skip comparing flash contents of boards up to date
+/// \retval true    History read
+/// \retval false   Error
+bool History::open(QString path, bool trusted) {
+  QMutexLocker lock{&_mutex};
+  _boards = {};
+  _runs = _lines = 0;
+  if (QFile file{path}; file.exists()) {
+    if (!file.open(QIODevice::ReadOnly)) {
+      qCritical().noquote() << "Can't open" << path;
+      return false;
+    }
+    while (!file.atEnd()) {
+      auto const bytes{file.readLine().trimmed()};
+      if (bytes.isEmpty()) continue;
+      ++_lines;
+      QJsonParseError error;
+      auto run{QJsonDocument::fromJson(bytes, &error).object()};
+      if (error.error != QJsonParseError::NoError) {
+        qWarning().noquote() << path << _lines << error.errorString();
+        continue;
+      }
+      fold(run.take("mac").toString(), run);
+    }
+  }
+  _path = path;
+  _trusted = trusted;
+  _open = true;
+  return true;
+}
+
+/// Check whether history is open
+///
+/// \retval true  Open
+/// \retval false Not open
+bool History::isOpen() const {
+  QMutexLocker lock{&_mutex};
+  return _open;
+}
+
+/// Check whether the history alone is enough to skip writing
+///
+/// \retval true  Trust history
+/// \retval false Compare flash contents as well
+bool History::isTrusted() const {
+  QMutexLocker lock{&_mutex};
+  return _trusted;
+}
+
+/// Check whether the last successful run on a board wrote the same binaries
+///
+/// \param  mac     MAC address
+/// \param  digest  Digest of binaries
+/// \retval true    Board up to date
+/// \retval false   Board unknown or not up to date
+bool History::upToDate(QString mac, QByteArray const& digest) const {
+  QMutexLocker lock{&_mutex};
+  auto const runs{_boards[mac].toArray()};
+  for (auto it{runs.crbegin()}; it != runs.crend(); ++it)
+    if (auto const run{it->toObject()};
+        run["result"] == "success" || run["result"] == "up to date")
+      return run["digest"].toString() == QString::fromLatin1(digest.toHex());
+  return false;
+}
+
+/// Record run
+///
+/// Runs without any binaries, e.g. backups, aren't recorded.
+///
+/// \param  mac     MAC address
+/// \param  bins    Binaries
+/// \param  digest  Digest of binaries
+/// \param  result  Result
+void History::record(QString mac,
+                     QVector<BinSource> const& bins,
+                     QByteArray const& digest,
+                     QString result) {
+  if (mac.isEmpty() || bins.isEmpty() || !isOpen()) return;
+
+  QJsonArray offsets;
+  for (auto const& bin : bins)
+    offsets.append("0x" + QString::number(bin.offset(), 16));
+  QJsonObject const run{
+    {"time", QDateTime::currentDateTimeUtc().toString(Qt::ISODate)},
+    {"digest", QString::fromLatin1(digest.toHex())},
+    {"offsets", offsets},
+    {"result", result}};
+
+  QMutexLocker lock{&_mutex};
+  if (!_open) return;
+  fold(mac, run);
+
+  // Runs dropped from memory are still in the file, get rid of them sometimes
+  if (++_lines > std::max(2 * _runs, min_compact_lines) && compact()) return;
+
+  if (QFile file{_path};
+      !file.open(QIODevice::Append) || file.write(line(mac, run)) < 0)
+    qCritical().noquote() << "Can't write" << _path;
+}
+
+/// Add run to board, dropping its oldest runs
+///
+/// \param  mac Board
+/// \param  run Run
+void History::fold(QString const& mac, QJsonObject run) {
+  auto runs{_boards[mac].toArray()};
+  runs.append(run);
+  ++_runs;
+  while (runs.size() > max_runs) {
+    runs.removeFirst();
+    --_runs;
+  }
+  _boards[mac] = runs;
+}
+
+/// Replace file by the runs kept in memory
+///
+/// \retval true  File compacted
+/// \retval false Error
+bool History::compact() {
+  QSaveFile file{_path};
+  if (!file.open(QIODevice::WriteOnly)) return false;
+  for (auto it{_boards.constBegin()}; it != _boards.constEnd(); ++it)
+    for (auto const& run : it->toArray())
+      if (file.write(line(it.key(), run.toObject())) < 0) return false;
+  if (!file.commit()) return false;
+  _lines = _runs;
+  return true;
+}
@@ -0,0 +1,75 @@
+// Copyright (C) 2025 Vincent Hamp
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/// Flash history
+///
+/// \file   history.hpp
+/// \author Vincent Hamp
+/// \date   19/10/2026
+
+#pragma once
+
+#include <QByteArray>
+#include <QJsonObject>
+#include <QMutex>
+#include <QString>
+#include <QVector>
+#include "bin_source.hpp"
+
+/// Which board got which firmware
+///
+/// History is a singleton which records every run by the MAC address of the
+/// board, along with a digest of the binaries, their offsets, the time and the
+/// result. Before writing, LoaderWorker asks History whether the last
+/// successful run on the same board wrote the same binaries. If so, the board
+/// is already up to date and writing gets skipped, optionally after comparing
+/// MD5 digests of the flash contents.
+///
+/// The history is kept as file with one JSON object per run and line, so
+/// recording a run only appends a line. Opening the history folds all lines
+/// into memory. Once the file contains a lot more lines than runs kept, it
+/// gets compacted. All calls are thread-safe.
+class History {
+public:
+  static History* get();
+  static QByteArray digest(QVector<BinSource> const& bins);
+
+  bool open(QString path, bool trusted = false);
+  bool isOpen() const;
+  bool isTrusted() const;
+  bool upToDate(QString mac, QByteArray const& digest) const;
+  void record(QString mac,
+              QVector<BinSource> const& bins,
+              QByteArray const& digest,
+              QString result);
+
+private:
+  History() = default;
+  History(History const&) = delete;
+  History(History&&) = delete;
+  History& operator=(History const&) = delete;
+  History& operator=(History&&) = delete;
+
+  void fold(QString const& mac, QJsonObject run);
+  bool compact();
+
+  QString _path{};
+  QJsonObject _boards{};
+  qsizetype _runs{};
+  qsizetype _lines{};
+  mutable QMutex _mutex{};
+  bool _trusted{};
+  bool _open{};
+};
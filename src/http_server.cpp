@@ -0,0 +1,106 @@
+// Copyright (C) 2025 Vincent Hamp
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/// Minimal HTTP server
+///
+/// \file   http_server.cpp
+/// \author Vincent Hamp
+/// \date   19/10/2026
+
+#include "http_server.hpp"
+#include <QTcpSocket>
+#include <QUrl>
+#include <memory>
+
+namespace {
+
+/// Requests larger than this are dropped
+inline constexpr auto max_request_size{16 * 1024};
+
+/// Get reason phrase of status code
+///
+/// \param  status  Status code
+/// \return Reason phrase
+QByteArray reason_phrase(int status) {
+  switch (status) {
+    case 200: return "OK";
+    case 400: return "Bad Request";
+    case 404: return "Not Found";
+    case 405: return "Method Not Allowed";
+    case 503: return "Service Unavailable";
+    default: return "Unknown";
+  }
+}
+
+/// Parse request line and headers
+///
+/// \param  head  Request line and headers
+/// \return Request
+HttpServer::Request parse_request(QByteArray const& head) {
+  HttpServer::Request req;
+  auto const lines{head.split('\n')};
+  if (auto const request_line{lines.first().trimmed().split(' ')};
+      request_line.size() == 3) {
+    req.method = request_line[0];
+    req.path = QUrl{QString::fromLatin1(request_line[1])}.path();
+  }
+  for (auto i{1}; i < lines.size(); ++i)
+    if (auto const colon{lines[i].indexOf(':')}; colon > 0)
+      req.headers.insert(lines[i].left(colon).trimmed().toLower(),
+                         lines[i].mid(colon + 1).trimmed());
+  return req;
+}
+
+} // namespace
+
+/// Ctor
+///
+/// \param  handler Request handler
+/// \param  parent  Parent
+HttpServer::HttpServer(Handler handler, QObject* parent)
+  : QTcpServer{parent}, _handler{handler} {
+  connect(
+    this, &QTcpServer::newConnection, this, &HttpServer::acceptConnection);
+}
+
+/// Accept pending connections and answer their requests
+void HttpServer::acceptConnection() {
+  while (auto const socket{nextPendingConnection()}) {
+    connect(socket,
+            &QTcpSocket::disconnected,
+            socket,
+            &QTcpSocket::deleteLater);
+
+    auto buffer{std::make_shared<QByteArray>()};
+    connect(socket, &QTcpSocket::readyRead, this, [this, socket, buffer] {
+      buffer->append(socket->readAll());
+      auto const end{buffer->indexOf("\r\n\r\n")};
+      if (end < 0 && buffer->size() < max_request_size) return;
+
+      auto const req{parse_request(buffer->left(end))};
+      auto const resp{end < 0 || req.method.isEmpty() ? Response{.status = 400}
+                      : req.method != "GET"           ? Response{.status = 405}
+                                                      : _handler(req)};
+      socket->write("HTTP/1.1 " + QByteArray::number(resp.status) + ' ' +
+                    reason_phrase(resp.status) + "\r\n" +
+                    "Content-Type: " + resp.content_type + "\r\n" +
+                    "Content-Length: " + QByteArray::number(resp.body.size()) +
+                    "\r\n" + "Connection: close\r\n\r\n");
+      socket->write(resp.body);
+      disconnect(socket, &QTcpSocket::readyRead, this, nullptr);
+      socket->disconnectFromHost();
+    });
+  }
+}
@@ -0,0 +1,61 @@
+// Copyright (C) 2025 Vincent Hamp
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/// Minimal HTTP server
+///
+/// \file   http_server.hpp
+/// \author Vincent Hamp
+/// \date   19/10/2026
+
+#pragma once
+
+#include <QHash>
+#include <QTcpServer>
+#include <functional>
+
+/// Minimal HTTP/1.1 server
+///
+/// HttpServer inherits a [QTcpServer](https://doc.qt.io/qt-6/qtcpserver.html)
+/// and answers each request by calling a handler. Only the request line and the
+/// headers are parsed, request bodies are not supported. Each connection gets
+/// closed after the response has been sent.
+class HttpServer : public QTcpServer {
+  Q_OBJECT
+
+public:
+  /// HTTP request
+  struct Request {
+    QByteArray method{};
+    QString path{};
+    QHash<QByteArray, QByteArray> headers{};
+  };
+
+  /// HTTP response
+  struct Response {
+    int status{200};
+    QByteArray content_type{"text/plain; charset=utf-8"};
+    QByteArray body{};
+  };
+
+  using Handler = std::function<Response(Request const&)>;
+
+  explicit HttpServer(Handler handler, QObject* parent = nullptr);
+
+private slots:
+  void acceptConnection();
+
+private:
+  Handler _handler{};
+};
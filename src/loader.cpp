@@ -0,0 +1,785 @@
+// Copyright (C) 2025 Vincent Hamp
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/// Serial protocol client
+///
+/// \file   loader.cpp
+/// \author Vincent Hamp
+/// \date   19/10/2026
+
+#include "loader.hpp"
+#include <QCryptographicHash>
+#include <QDeadlineTimer>
+#include <QDebug>
+#include <QFile>
+#include <QJsonDocument>
+#include <QThread>
+#include <QtEndian>
+#include <algorithm>
+#include <concepts>
+#include <esp_flasher/available_ports.hpp>
+
+namespace {
+
+/// Serial protocol commands
+enum Command : uint8_t {
+  FlashBegin = 0x02u,
+  FlashData = 0x03u,
+  FlashEnd = 0x04u,
+  MemBegin = 0x05u,
+  MemEnd = 0x06u,
+  MemData = 0x07u,
+  Sync = 0x08u,
+  WriteReg = 0x09u,
+  ReadReg = 0x0Au,
+  SpiSetParams = 0x0Bu,
+  SpiAttach = 0x0Du,
+  ChangeBaudrate = 0x0Fu,
+  FlashDeflBegin = 0x10u,
+  FlashDeflData = 0x11u,
+  FlashDeflEnd = 0x12u,
+  SpiFlashMd5 = 0x13u,
+  ReadFlash = 0xD2u, // Stub only
+};
+
+/// ROM loader appends 4 status bytes to each response, the stub only 2
+inline constexpr auto rom_status_bytes{4};
+inline constexpr auto stub_status_bytes{2};
+
+/// Maximum size of a data packet accepted by the ROM loader and the stub
+inline constexpr uint32_t rom_flash_write_size{0x400u};
+inline constexpr uint32_t stub_flash_write_size{0x4000u};
+
+/// Maximum size of a data packet when uploading to RAM
+inline constexpr uint32_t ram_block_size{0x1800u};
+
+/// Register which can be read on any chip, used to check if the target is alive
+inline constexpr uint32_t chip_detect_magic_reg{0x40001000u};
+
+/// eFuse words containing the factory MAC address
+inline constexpr uint32_t efuse_mac0_reg{0x60007044u};
+inline constexpr uint32_t efuse_mac1_reg{0x60007048u};
+
+/// Block size and maximum number of unacknowledged blocks when reading flash
+inline constexpr uint32_t read_flash_block_size{0x1000u};
+inline constexpr uint32_t read_flash_max_inflight{64u};
+
+/// Timeouts per MB (esptool uses the same values)
+inline constexpr auto erase_region_timeout_per_mb{30000};
+inline constexpr auto erase_write_timeout_per_mb{40000};
+inline constexpr auto md5_timeout_per_mb{8000};
+
+/// Scale timeout with size, but never go below the default
+///
+/// \param  ms_per_mb Timeout per MB
+/// \param  size      Size in bytes
+/// \return Timeout in ms
+int timeout_per_mb(int ms_per_mb, uint32_t size) {
+  return std::max(3000, static_cast<int>(ms_per_mb * (size / 1e6)));
+}
+
+/// Pack 32-bit words as little endian
+///
+/// \param  words Words
+/// \return Packed words
+template<std::convertible_to<uint32_t>... Ts>
+QByteArray pack(Ts... words) {
+  QByteArray bytes(static_cast<qsizetype>(sizeof...(Ts) * 4u), '\0');
+  auto ptr{bytes.data()};
+  ((qToLittleEndian(static_cast<uint32_t>(words), ptr), ptr += 4), ...);
+  return bytes;
+}
+
+/// Checksum of data packets
+///
+/// \param  data  Data
+/// \return Checksum
+uint32_t checksum(QByteArray const& data) {
+  uint8_t chk{0xEFu};
+  for (auto const c : data) chk ^= static_cast<uint8_t>(c);
+  return chk;
+}
+
+/// Encode packet as SLIP frame
+///
+/// \param  packet  Packet
+/// \return SLIP encoded frame
+QByteArray slip_encode(QByteArray const& packet) {
+  QByteArray frame;
+  frame.reserve(packet.size() + packet.size() / 16 + 2);
+  frame.append('\xC0');
+  for (auto const c : packet)
+    switch (static_cast<uint8_t>(c)) {
+      case 0xC0u: frame.append("\xDB\xDC", 2); break;
+      case 0xDBu: frame.append("\xDB\xDD", 2); break;
+      default: frame.append(c); break;
+    }
+  frame.append('\xC0');
+  return frame;
+}
+
+/// Create SLIP encoded command frame
+///
+/// \param  op    Command
+/// \param  data  Data
+/// \param  chk   Checksum
+/// \return SLIP encoded frame
+QByteArray make_frame(uint8_t op, QByteArray const& data, uint32_t chk) {
+  QByteArray packet(8, '\0');
+  packet[1] = static_cast<char>(op);
+  qToLittleEndian(static_cast<uint16_t>(data.size()), packet.data() + 2);
+  qToLittleEndian(chk, packet.data() + 4);
+  packet.append(data);
+  return slip_encode(packet);
+}
+
+/// Decode SLIP frame without delimiters
+///
+/// \param  frame SLIP encoded frame
+/// \return Decoded packet
+QByteArray slip_decode(QByteArray const& frame) {
+  QByteArray packet;
+  packet.reserve(frame.size());
+  for (auto it{frame.cbegin()}; it != frame.cend(); ++it)
+    if (*it == '\xDB' && it + 1 != frame.cend()) {
+      ++it;
+      packet.append(*it == '\xDC' ? '\xC0' : '\xDB');
+    } else packet.append(*it);
+  return packet;
+}
+
+/// Create SLIP encoded data frame
+///
+/// \param  op          Command
+/// \param  bytes       Payload
+/// \param  block_size  Block size
+/// \param  seq         Sequence number
+/// \return SLIP encoded frame
+QByteArray make_data_frame(uint8_t op,
+                           QByteArray const& bytes,
+                           uint32_t block_size,
+                           uint32_t seq) {
+  auto const block{bytes.mid(seq * block_size, block_size)};
+  return make_frame(op,
+                    pack(static_cast<uint32_t>(block.size()), seq, 0u, 0u) +
+                      block,
+                    checksum(block));
+}
+
+} // namespace
+
+/// Ctor
+///
+/// \param  port_name Serial port name, network address or "auto"
+/// \param  cancelled Callback which stops calls once it returns true
+Loader::Loader(QString port_name, std::function<bool()> cancelled)
+  : _port_name{port_name}, _cancelled{cancelled} {}
+
+/// Open serial port and sync with ROM loader
+///
+/// If the port name is "auto" all available ports get tried.
+///
+/// \retval true  Synced
+/// \retval false Error
+bool Loader::open() {
+  _transport.reset();
+  if (_port_name != "auto") return openPort(_port_name);
+  for (auto const& port_info : available_ports())
+    if (openPort(port_info.portName())) return true;
+  _error_string = "No device found";
+  return false;
+}
+
+/// Close serial port
+void Loader::close() {
+  if (_transport) _transport->close();
+  _rx.clear();
+  _stub = false;
+}
+
+/// Upload flasher stub to RAM and run it
+///
+/// \retval true  Stub running
+/// \retval false Error
+bool Loader::runStub() {
+  QFile file{":/stubs/stub_flasher_32s3.json"};
+  if (!file.open(QIODevice::ReadOnly)) {
+    _error_string = file.errorString();
+    return false;
+  }
+  QJsonDocument const doc{QJsonDocument::fromJson(file.readAll())};
+
+  // Upload text and data segments
+  for (auto const segment : {"text", "data"}) {
+    auto const bytes{
+      QByteArray::fromBase64(doc[segment].toString().toLatin1())};
+    auto const size{static_cast<uint32_t>(bytes.size())};
+    auto const start{
+      static_cast<uint32_t>(doc[QString{segment} + "_start"].toInteger())};
+    auto const num_blocks{(size + ram_block_size - 1u) / ram_block_size};
+    if (!command(MemBegin, pack(size, num_blocks, ram_block_size, start)))
+      return false;
+    for (auto seq{0u}; seq < num_blocks; ++seq)
+      if (!write(make_data_frame(MemData, bytes, ram_block_size, seq)) ||
+          !response(MemData))
+        return false;
+  }
+
+  // Jump to entry point, the response might get lost but the stub greets us
+  auto const entry{static_cast<uint32_t>(doc["entry"].toInteger())};
+  if (!write(make_frame(MemEnd, pack(0u, entry), 0u))) return false;
+  QDeadlineTimer const deadline{3000};
+  while (auto const frame{
+           readFrame(static_cast<int>(deadline.remainingTime()))})
+    if (*frame == "OHAI") {
+      _stub = true;
+      return true;
+    }
+
+  _error_string = "Failed to run stub";
+  return false;
+}
+
+/// Change baud rate of ROM loader and serial port
+///
+/// \param  baud_rate Baud rate
+/// \retval true      Baud rate changed
+/// \retval false     Error
+bool Loader::changeBaudRate(qint32 baud_rate) {
+  // Stub wants to know the current baud rate
+  if (!command(ChangeBaudrate,
+               pack(static_cast<uint32_t>(baud_rate),
+                    _stub ? static_cast<uint32_t>(_transport->baudRate())
+                          : 0u)))
+    return false;
+  if (!_transport->setBaudRate(baud_rate)) {
+    _error_string = _transport->errorString();
+    return false;
+  }
+  // Give the target some time to switch
+  QThread::msleep(50u);
+  _transport->clear();
+  _rx.clear();
+  return true;
+}
+
+/// Attach SPI flash
+///
+/// \retval true  Attached
+/// \retval false Error
+bool Loader::spiAttach() {
+  return command(SpiAttach, _stub ? pack(0u) : pack(0u, 0u)).has_value();
+}
+
+/// Set SPI flash parameters
+///
+/// \param  flash_size  Flash size in bytes
+/// \retval true        Parameters set
+/// \retval false       Error
+bool Loader::spiSetParams(uint32_t flash_size) {
+  return command(SpiSetParams,
+                 pack(0u, flash_size, 64u * 1024u, 4u * 1024u, 256u, 0xFFFFu))
+    .has_value();
+}
+
+/// Write deflated binary
+///
+/// \param  offset    Flash offset
+/// \param  size      Uncompressed size
+/// \param  deflated  zlib compressed binary
+/// \retval true      Binary written
+/// \retval false     Error
+bool Loader::writeDeflated(uint32_t offset,
+                           uint32_t size,
+                           QByteArray const& deflated) {
+  auto const block_size{_stub ? stub_flash_write_size : rom_flash_write_size};
+  auto const num_blocks{
+    (static_cast<uint32_t>(deflated.size()) + block_size - 1u) / block_size};
+
+  // Stub erases on the fly, ROM loader erases the whole region right away
+  if (_stub) {
+    if (!command(FlashDeflBegin, pack(size, num_blocks, block_size, offset)))
+      return false;
+  } else if (auto const write_size{(size + block_size - 1u) / block_size *
+                                   block_size};
+             !command(FlashDeflBegin,
+                      pack(write_size, num_blocks, block_size, offset, 0u),
+                      0u,
+                      timeout_per_mb(erase_region_timeout_per_mb, write_size)))
+    return false;
+
+  // Worst case timeout assumes average compression ratio
+  auto const timeout{timeout_per_mb(
+    erase_write_timeout_per_mb,
+    static_cast<uint32_t>(static_cast<uint64_t>(block_size) * size /
+                          std::max<qsizetype>(deflated.size(), 1)))};
+
+  return writeBlocks(FlashDeflData, offset, size, deflated, timeout);
+}
+
+/// Write binary uncompressed
+///
+/// Only worth it if the link is faster than the target can inflate, e.g. with
+/// data which doesn't compress well anyway. Like esptool, the last block gets
+/// padded with 0xFF, which leaves erased flash untouched.
+///
+/// \param  offset  Flash offset
+/// \param  bytes   Binary
+/// \retval true    Binary written
+/// \retval false   Error
+bool Loader::writeRaw(uint32_t offset, QByteArray const& bytes) {
+  auto const block_size{_stub ? stub_flash_write_size : rom_flash_write_size};
+  auto const size{static_cast<uint32_t>(bytes.size())};
+  auto const num_blocks{(size + block_size - 1u) / block_size};
+
+  // Stub erases on the fly, ROM loader erases the whole region right away
+  if (_stub) {
+    if (!command(FlashBegin, pack(size, num_blocks, block_size, offset)))
+      return false;
+  } else if (!command(FlashBegin,
+                      pack(size, num_blocks, block_size, offset, 0u),
+                      0u,
+                      timeout_per_mb(erase_region_timeout_per_mb, size)))
+    return false;
+
+  auto padded{bytes};
+  padded.resize(num_blocks * block_size, '\xFF');
+  return writeBlocks(FlashData,
+                     offset,
+                     size,
+                     padded,
+                     timeout_per_mb(erase_write_timeout_per_mb, block_size));
+}
+
+/// Read flash
+///
+/// Only supported by the stub. The stub keeps sending blocks as long as no more
+/// than 64 of them are unacknowledged, so the link never runs dry. Each block
+/// is acknowledged right away and then handed to the sink, memory usage does
+/// not depend on the size of the range. At the end the MD5 digest sent by the
+/// stub gets compared to the one of the received data.
+///
+/// \param  offset  Flash offset
+/// \param  size    Size in bytes
+/// \param  sink    Callback receiving the data, returns false on error
+/// \retval true    Range read
+/// \retval false   Error
+bool Loader::readFlash(uint32_t offset,
+                       uint32_t size,
+                       std::function<bool(QByteArray const&)> const& sink) {
+  if (!_stub) {
+    _error_string = "Reading flash requires the stub";
+    return false;
+  }
+
+  if (!command(
+        ReadFlash,
+        pack(offset, size, read_flash_block_size, read_flash_max_inflight)))
+    return false;
+
+  QCryptographicHash md5{QCryptographicHash::Md5};
+  uint32_t received{};
+  auto last_pct{-1};
+  while (received < size) {
+    auto const block{readFrame(3000)};
+    if (!block) {
+      if (!interrupted())
+        _error_string = "Timeout reading flash at 0x" +
+                        QString::number(offset + received, 16);
+      return false;
+    }
+
+    // Only the last block may be shorter
+    received += static_cast<uint32_t>(block->size());
+    if (received > size ||
+        (received < size && block->size() < read_flash_block_size)) {
+      _error_string = "Corrupt data reading flash at 0x" +
+                      QString::number(offset + received, 16);
+      return false;
+    }
+
+    // Acknowledge first, so the stub can go on while we're busy with the sink
+    if (!write(slip_encode(pack(received)))) return false;
+    md5.addData(*block);
+    if (!sink(*block)) {
+      _error_string = "Failed to store data read from flash";
+      return false;
+    }
+
+    // Don't flood the log
+    if (auto const pct{static_cast<int>(100u * uint64_t{received} / size)};
+        pct != last_pct) {
+      last_pct = pct;
+      qDebug().nospace() << "Reading at 0x" << Qt::hex << offset + received
+                         << Qt::dec << "... (" << pct << "%)";
+    }
+  }
+
+  auto const digest{readFrame(3000)};
+  if (!digest || digest->size() != 16) {
+    if (!interrupted())
+      _error_string = "Missing MD5 digest after reading flash";
+    return false;
+  } else if (*digest != md5.result()) {
+    _error_string = "MD5 mismatch after reading flash";
+    return false;
+  }
+
+  return true;
+}
+
+/// Finish writing
+///
+/// The stub buffers data, so it needs to be told that we're done. The ROM
+/// loader on the other hand would leave download mode, so skip it there.
+///
+/// \retval true  Finished
+/// \retval false Error
+bool Loader::finish() {
+  if (!_stub) return true;
+  return command(FlashBegin, pack(0u, 0u, stub_flash_write_size, 0u)) &&
+         command(FlashDeflEnd, pack(1u));
+}
+
+/// Calculate MD5 digest of flash region
+///
+/// \param  offset        Flash offset
+/// \param  size          Size in bytes
+/// \return Digest        Raw 16 byte digest
+/// \return std::nullopt  Error
+std::optional<QByteArray> Loader::flashMd5(uint32_t offset, uint32_t size) {
+  auto const resp{command(SpiFlashMd5,
+                          pack(offset, size, 0u, 0u),
+                          0u,
+                          timeout_per_mb(md5_timeout_per_mb, size))};
+  if (!resp) return std::nullopt;
+  // ROM loader answers with hex digits, the stub with raw bytes
+  else if (resp->data.size() == 32) return QByteArray::fromHex(resp->data);
+  else if (resp->data.size() == 16) return resp->data;
+  _error_string = "Invalid MD5 response";
+  return std::nullopt;
+}
+
+/// Check whether the target still answers
+///
+/// Anything left over from before gets discarded. A frame which got cut off
+/// is terminated by the first delimiter sent, so the command may need a second
+/// try.
+///
+/// \retval true  Target answers
+/// \retval false Error
+bool Loader::ping() {
+  if (!_transport || !_transport->isOpen()) return false;
+  for (auto i{0}; i < 2; ++i) {
+    if (interrupted()) return false;
+    _transport->clear();
+    _rx.clear();
+    if (command(ReadReg, pack(chip_detect_magic_reg), 0u, 500)) return true;
+  }
+  return false;
+}
+
+/// Reconnect after a transmission error
+///
+/// If the target doesn't answer a ping, the port gets reopened at the current
+/// baud rate and synced again. The target isn't reset, so the stub keeps
+/// running if it did before.
+///
+/// \retval true  Reconnected
+/// \retval false Error
+bool Loader::reconnect() {
+  if (ping()) return true;
+
+  auto const name{portName()};
+  auto const baud_rate{_transport->baudRate()};
+  auto const stub{_stub};
+  close();
+  _transport = Transport::create(name);
+  if (!_transport->open() || !_transport->setBaudRate(baud_rate)) {
+    _error_string = _transport->errorString();
+    return false;
+  }
+  _stub = stub;
+  if (sync()) return true;
+  close();
+  return false;
+}
+
+/// Read register
+///
+/// \param  address Address
+/// \return Value of register or std::nullopt on error
+std::optional<uint32_t> Loader::readReg(uint32_t address) {
+  if (auto const resp{command(ReadReg, pack(address))}) return resp->value;
+  return std::nullopt;
+}
+
+/// Read factory MAC address from eFuses
+///
+/// \return MAC address (e.g. "f4:12:fa:01:02:03") or empty string on error
+QString Loader::readMac() {
+  auto const mac0{readReg(efuse_mac0_reg)};
+  auto const mac1{mac0 ? readReg(efuse_mac1_reg) : std::nullopt};
+  if (!mac1) return {};
+  uint8_t bytes[6]{};
+  qToBigEndian(static_cast<uint16_t>(*mac1 & 0xFFFFu), bytes);
+  qToBigEndian(*mac0, bytes + 2);
+  return QByteArray{reinterpret_cast<char const*>(bytes), sizeof(bytes)}.toHex(
+    ':');
+}
+
+/// Get name of serial port
+///
+/// \return Name of serial port
+QString Loader::portName() const {
+  return _transport ? _transport->name() : _port_name;
+}
+
+/// Get description of last error
+///
+/// \return Description of last error
+QString Loader::errorString() const { return _error_string; }
+
+/// Get current baud rate
+///
+/// \return Baud rate
+qint32 Loader::baudRate() const {
+  return _transport ? _transport->baudRate() : 0;
+}
+
+/// Get number of blocks acknowledged by last write
+///
+/// \return Number of blocks
+uint32_t Loader::ackedBlocks() const { return _acked_blocks; }
+
+/// Check whether the baud rate can be changed
+///
+/// \retval true  Baud rate can be changed
+/// \retval false Baud rate is fixed (e.g. raw TCP)
+bool Loader::supportsBaudRate() const {
+  return _transport && _transport->supportsBaudRate();
+}
+
+/// Check whether stub is running
+///
+/// \retval true  Stub running
+/// \retval false ROM loader running
+bool Loader::isStub() const { return _stub; }
+
+/// Open specific serial port and sync with ROM loader
+///
+/// \param  port_name Serial port name
+/// \retval true      Synced
+/// \retval false     Error
+bool Loader::openPort(QString port_name) {
+  close();
+  _transport = Transport::create(port_name);
+  if (!_transport->open()) {
+    _error_string = _transport->errorString();
+    return false;
+  }
+  if (sync()) return true;
+  close();
+  return false;
+}
+
+/// Sync with ROM loader
+///
+/// \retval true  Synced
+/// \retval false Error
+bool Loader::sync() {
+  QByteArray data{"\x07\x07\x12\x20", 4};
+  data.append(32, '\x55');
+
+  for (auto i{0}; i < 7; ++i) {
+    if (interrupted()) return false;
+    _transport->clear();
+    _rx.clear();
+    if (!write(make_frame(Sync, data, 0u)) || !response(Sync, 100)) continue;
+    // ROM loader answers sync multiple times, drain them all
+    while (readFrame(100)) {}
+    return true;
+  }
+
+  _error_string = "Failed to sync with " + _transport->name();
+  return false;
+}
+
+/// Write command and wait for response
+///
+/// \param  op          Command
+/// \param  data        Data
+/// \param  chk         Checksum
+/// \param  timeout     Timeout in ms
+/// \return Response    Response
+/// \return std::nullopt Error
+std::optional<Loader::Response> Loader::command(uint8_t op,
+                                                QByteArray const& data,
+                                                uint32_t chk,
+                                                int timeout) {
+  if (!write(make_frame(op, data, chk))) return std::nullopt;
+  return response(op, timeout);
+}
+
+/// Wait for response to command
+///
+/// Frames not matching the command (e.g. repeated sync responses) are ignored.
+///
+/// \param  op            Command
+/// \param  timeout       Timeout in ms
+/// \return Response      Response
+/// \return std::nullopt  Error
+std::optional<Loader::Response> Loader::response(uint8_t op, int timeout) {
+  QDeadlineTimer const deadline{timeout};
+  while (auto const frame{
+           readFrame(static_cast<int>(deadline.remainingTime()))}) {
+    if (frame->size() < 8 || frame->at(0) != '\x01' ||
+        static_cast<uint8_t>(frame->at(1)) != op)
+      continue;
+
+    auto const size{qFromLittleEndian<uint16_t>(frame->constData() + 2)};
+    Response resp{.value = qFromLittleEndian<uint32_t>(frame->constData() + 4),
+                  .data = frame->mid(8, size)};
+    auto const status_bytes{_stub ? stub_status_bytes : rom_status_bytes};
+    if (resp.data.size() < status_bytes) {
+      _error_string =
+        "Invalid response to command 0x" + QString::number(op, 16);
+      return std::nullopt;
+    }
+
+    // Check status bytes and remove them
+    auto const status{resp.data.right(status_bytes)};
+    resp.data.chop(status_bytes);
+    if (status[0] != '\0') {
+      _error_string = "Command 0x" + QString::number(op, 16) +
+                      " failed with error 0x" +
+                      QString::number(static_cast<uint8_t>(status[1]), 16);
+      return std::nullopt;
+    }
+
+    return resp;
+  }
+
+  if (!interrupted())
+    _error_string = "Timeout waiting for response to command 0x" +
+                    QString::number(op, 16);
+  return std::nullopt;
+}
+
+/// Read SLIP frame
+///
+/// \param  timeout       Timeout in ms
+/// \return Frame         Decoded frame
+/// \return std::nullopt  Timeout
+std::optional<QByteArray> Loader::readFrame(int timeout) {
+  QDeadlineTimer const deadline{timeout + _transport->latency()};
+  for (;;) {
+    _rx.append(_transport->readAll());
+
+    // Drop anything in front of the first delimiter
+    if (auto const begin{_rx.indexOf('\xC0')}; begin < 0) _rx.clear();
+    else {
+      _rx.remove(0, begin);
+      // Keep the closing delimiter, it might be the opening one of the next
+      // frame if we lost sync
+      if (auto const end{_rx.indexOf('\xC0', 1)}; end == 1) {
+        _rx.remove(0, 1);
+        continue;
+      } else if (end > 1) {
+        auto const frame{slip_decode(_rx.mid(1, end - 1))};
+        _rx.remove(0, end);
+        return frame;
+      }
+    }
+
+    if (interrupted() || deadline.hasExpired() ||
+        !_transport->waitForReadyRead(
+          static_cast<int>(deadline.remainingTime())))
+      return std::nullopt;
+  }
+}
+
+/// Write data blocks
+///
+/// The frame of the next block is already prepared while the target is still
+/// busy with the current one. As soon as the acknowledgement arrives, the next
+/// frame gets handed to the serial port.
+///
+/// \param  op      FlashData or FlashDeflData
+/// \param  offset  Flash offset
+/// \param  size    Uncompressed size
+/// \param  bytes   Payload
+/// \param  timeout Timeout per block
+/// \retval true    Blocks written
+/// \retval false   Error
+bool Loader::writeBlocks(uint8_t op,
+                         uint32_t offset,
+                         uint32_t size,
+                         QByteArray const& bytes,
+                         int timeout) {
+  auto const block_size{_stub ? stub_flash_write_size : rom_flash_write_size};
+  auto const num_blocks{
+    (static_cast<uint32_t>(bytes.size()) + block_size - 1u) / block_size};
+
+  _acked_blocks = 0u;
+  auto frame{make_data_frame(op, bytes, block_size, 0u)};
+  auto last_pct{-1};
+  for (auto seq{0u}; seq < num_blocks; ++seq) {
+    if (interrupted() || !write(frame)) return false;
+
+    // Prepare next frame while the target is busy
+    if (seq + 1u < num_blocks)
+      frame = make_data_frame(op, bytes, block_size, seq + 1u);
+
+    if (!response(op, timeout)) return false;
+    _acked_blocks = seq + 1u;
+
+    // Don't flood the log
+    auto const written{static_cast<uint64_t>(size) * (seq + 1u) / num_blocks};
+    if (auto const pct{static_cast<int>(100u * (seq + 1u) / num_blocks)};
+        pct != last_pct) {
+      last_pct = pct;
+      qDebug().nospace() << "Writing at 0x" << Qt::hex << offset + written
+                         << Qt::dec << "... (" << pct << "%)";
+    }
+  }
+
+  return true;
+}
+
+/// Write frame
+///
+/// \param  frame SLIP encoded frame
+/// \retval true  Frame written
+/// \retval false Error
+bool Loader::write(QByteArray const& frame) {
+  if (!_transport->write(frame)) {
+    _error_string = _transport->errorString();
+    return false;
+  }
+  return true;
+}
+
+/// Check whether the thread or the caller has asked to stop
+///
+/// \retval true  Interrupted
+/// \retval false Not interrupted
+bool Loader::interrupted() {
+  if (!QThread::currentThread()->isInterruptionRequested() &&
+      !(_cancelled && _cancelled()))
+    return false;
+  _error_string = "Interrupted";
+  return true;
+}
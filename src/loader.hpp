@@ -0,0 +1,117 @@
+// Copyright (C) 2025 Vincent Hamp
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/// Serial protocol client
+///
+/// \file   loader.hpp
+/// \author Vincent Hamp
+/// \date   19/10/2026
+
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include "transport.hpp"
+
+/// Client for the serial protocol of the ESP32-S3 ROM loader
+///
+/// Loader talks to the ROM loader using the
+/// [serial protocol](https://docs.espressif.com/projects/esptool/en/latest/esp32s3/advanced-topics/serial-protocol.html)
+/// directly. The protocol allows only one command in flight, so each block
+/// still waits for the acknowledgement of the previous one. Throughput comes
+/// from compressing the data, the larger blocks and asynchronous flash writes
+/// of the stub and a higher baud rate instead.
+///
+/// Optionally a flasher stub can be uploaded to RAM first by calling
+/// Loader::runStub(). The stub accepts larger blocks, erases on the fly and
+/// supports commands the ROM loader does not, e.g. reading flash. The stub
+/// itself is taken from [esptool](https://github.com/espressif/esptool) and
+/// embedded as Qt resource.
+///
+/// The target is reached through a Transport, either a local serial port or a
+/// serial port server on the network. Timeouts are extended by the latency of
+/// the transport.
+///
+/// All calls block and must be made from a worker thread. They return early
+/// once the thread gets interrupted or the optional cancel callback returns
+/// true. Errors are reported by returning false, a description is available
+/// through Loader::errorString().
+class Loader {
+public:
+  explicit Loader(QString port_name,
+                  std::function<bool()> cancelled = nullptr);
+
+  bool open();
+  void close();
+  bool runStub();
+  bool changeBaudRate(qint32 baud_rate);
+  bool spiAttach();
+  bool spiSetParams(uint32_t flash_size);
+  bool writeDeflated(uint32_t offset,
+                     uint32_t size,
+                     QByteArray const& deflated);
+  bool writeRaw(uint32_t offset, QByteArray const& bytes);
+  bool readFlash(uint32_t offset,
+                 uint32_t size,
+                 std::function<bool(QByteArray const&)> const& sink);
+  bool finish();
+  std::optional<QByteArray> flashMd5(uint32_t offset, uint32_t size);
+  bool ping();
+  bool reconnect();
+  std::optional<uint32_t> readReg(uint32_t address);
+  QString readMac();
+
+  QString portName() const;
+  QString errorString() const;
+  qint32 baudRate() const;
+  uint32_t ackedBlocks() const;
+  bool supportsBaudRate() const;
+  bool isStub() const;
+
+private:
+  /// Response to a command
+  struct Response {
+    uint32_t value{};
+    QByteArray data{};
+  };
+
+  bool openPort(QString port_name);
+  bool sync();
+  std::optional<Response> command(uint8_t op,
+                                  QByteArray const& data,
+                                  uint32_t chk = 0u,
+                                  int timeout = 3000);
+  std::optional<Response> response(uint8_t op, int timeout = 3000);
+  std::optional<QByteArray> readFrame(int timeout);
+  bool writeBlocks(uint8_t op,
+                   uint32_t offset,
+                   uint32_t size,
+                   QByteArray const& bytes,
+                   int timeout);
+  bool write(QByteArray const& frame);
+  bool interrupted();
+
+  std::unique_ptr<Transport> _transport{};
+  QString _port_name{};
+  std::function<bool()> _cancelled{};
+  QString _error_string{};
+  QByteArray _rx{};
+  uint32_t _acked_blocks{};
+  bool _stub{};
+};
@@ -0,0 +1,536 @@
+// Copyright (C) 2025 Vincent Hamp
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/// Pipelined flasher
+///
+/// \file   loader_worker.cpp
+/// \author Vincent Hamp
+/// \date   19/10/2026
+
+#include "loader_worker.hpp"
+#include <QCryptographicHash>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <algorithm>
+#include <memory>
+#include <numeric>
+#include <optional>
+#include <utility>
+#include <quagzipfile.h>
+#include "archive.hpp"
+#include "cost_model.hpp"
+#include "history.hpp"
+#include "production_log.hpp"
+#include "provisioning.hpp"
+
+namespace {
+
+/// Number of times writing a binary gets resumed before giving up
+inline constexpr auto max_retries{3};
+
+/// Flash sector size, resuming starts at sector boundaries
+inline constexpr uint32_t sector_size{0x1000u};
+
+/// Calculate MD5 digest of part of a binary
+///
+/// \param  bin           Binary
+/// \param  pos           Position
+/// \param  size          Size in bytes
+/// \return Digest        MD5 digest
+/// \return std::nullopt  Error
+std::optional<QByteArray>
+md5(BinSource const& bin, uint32_t pos, uint32_t size) {
+  QCryptographicHash hash{QCryptographicHash::Md5};
+  if (!bin.hash(hash, pos, size)) return std::nullopt;
+  return hash.result();
+}
+
+/// Get flash size from bootloader image header
+///
+/// \param  header        Start of bootloader image
+/// \return Flash size    Flash size in bytes
+/// \return std::nullopt  No bootloader image
+std::optional<uint32_t> flash_size(QByteArray const& header) {
+  if (header.size() > 3 && header[0] == '\xE9')
+    return (1024u * 1024u) << (static_cast<uint8_t>(header[3]) >> 4u);
+  return std::nullopt;
+}
+
+/// Get flash size from bootloader binary
+///
+/// \param  bins          Binaries
+/// \return Flash size    Flash size in bytes
+/// \return std::nullopt  No bootloader found
+std::optional<uint32_t> flash_size(QVector<BinSource> const& bins) {
+  for (auto const& bin : bins)
+    if (bin.offset() == 0u)
+      if (auto const header{bin.read(0u, 16u)}) return flash_size(*header);
+  return std::nullopt;
+}
+
+} // namespace
+
+/// Ctor
+///
+/// \param  port  Serial port name or "auto"
+LoaderWorker::LoaderWorker(QString port) : _port{port} {}
+
+/// Get serial port name
+///
+/// \return Serial port name or "auto"
+QString LoaderWorker::port() const { return _port; }
+
+/// Queue job
+///
+/// May be called from any thread, the job runs on the thread of the worker
+/// once all jobs queued before are done.
+///
+/// \param  job Job
+void LoaderWorker::start(Job job) {
+  auto const id{++_queued};
+  QElapsedTimer queued;
+  queued.start();
+  QMetaObject::invokeMethod(
+    this, [this, id, queued, job = std::move(job)]() mutable {
+      // Time between queueing and the job actually running
+      Metrics::get()->queued(queued.elapsed() / 1000.0);
+      _id = id;
+      run(std::move(job));
+    });
+}
+
+/// Stop running and queued jobs
+///
+/// Jobs queued afterwards aren't affected. May be called from any thread.
+void LoaderWorker::cancel() { _cancelled = _queued.load(); }
+
+/// Check whether the running job got cancelled
+///
+/// \retval true  Cancelled
+/// \retval false Not cancelled
+bool LoaderWorker::cancelled() const { return _id <= _cancelled; }
+
+/// Run job
+///
+/// \param  job Job
+void LoaderWorker::run(Job job) {
+  QElapsedTimer timer;
+  timer.start();
+  _job = std::move(job);
+  _digest = {};
+  _up_to_date = false;
+  ProductionLog::setContext(
+    {.port = _port, .firmware = firmware_version(_job.bins)});
+
+  // Runs which don't write anything, e.g. backups, don't concern the history
+  auto const record{[this](QString result) {
+    if (auto const mac{ProductionLog::context().mac};
+        !_job.bins.isEmpty() && !mac.isEmpty() && History::get()->isOpen())
+      History::get()->record(mac, _job.bins, digest(), result);
+  }};
+
+  if (!flash()) {
+    if (auto const str{_loader ? _loader->errorString() : QString{}};
+        !str.isEmpty())
+      qCritical().noquote() << str;
+    // Don't count runs stopped by the user
+    if (cancelled()) ProductionLog::get()->result("interrupted");
+    else {
+      ProductionLog::get()->result("failure");
+      record("failure");
+      Metrics::get()->failed(_phase);
+    }
+  } else {
+    auto const result{_up_to_date ? "up to date" : "success"};
+    ProductionLog::get()->result(result);
+    record(result);
+    // Nor are they boards flashed
+    if (!_job.bins.isEmpty())
+      Metrics::get()->flashed(
+        _up_to_date
+          ? qsizetype{}
+          : std::accumulate(_job.bins.cbegin(),
+                            _job.bins.cend(),
+                            qsizetype{},
+                            [](qsizetype size, BinSource const& bin) {
+                              return size + bin.size();
+                            }),
+        timer.elapsed() / 1000.0);
+  }
+
+  // Rates measured while writing get stored once per run
+  CostModel::get()->save();
+  emit finished();
+}
+
+/// Write binaries
+///
+/// \retval true  Binaries written
+/// \retval false Error
+bool LoaderWorker::flash() {
+  // Per-board image takes the place of the binary at its offset
+  std::optional<uint32_t> provisioned;
+  if (_job.provision) {
+    _phase = Metrics::Phase::Write;
+    if (!(provisioned = Provisioning::get()->offset(_job.bins))) {
+      qCritical() << "No NVS partition found";
+      return false;
+    }
+    _job.bins.removeIf([offset = *provisioned](BinSource const& bin) {
+      return bin.offset() == offset;
+    });
+  }
+
+  // Reading the first binary starts while we're busy syncing
+  auto reader{_job.bins.isEmpty()
+                ? nullptr
+                : std::make_unique<BinReader>(_job.bins.front())};
+
+  if (!session()) return false;
+  auto& loader{*_loader};
+
+  if (auto const size{flash_size(_job.bins)};
+      size && !loader.spiSetParams(*size))
+    return false;
+
+  if (_job.backup) {
+    _phase = Metrics::Phase::Read;
+    if (!backup(loader)) return false;
+  }
+
+  // Board got the same binaries last time
+  if ((_up_to_date = upToDate(loader, _mac))) {
+    qInfo() << "Already up to date";
+    return loader.finish();
+  }
+
+  _phase = Metrics::Phase::Write;
+
+  // History only refers to the binaries of the archive
+  if (provisioned) {
+    if (History::get()->isOpen()) digest();
+    auto const bin{Provisioning::get()->next(_job.bins)};
+    if (!bin) return false;
+    replace(_job.bins, BinSource{*bin});
+    if (_job.bins.front().offset() == *provisioned)
+      reader = std::make_unique<BinReader>(_job.bins.front());
+  }
+
+  for (auto i{0}; i < _job.bins.size(); ++i)
+    if (!write(loader,
+               _job.bins[i],
+               std::exchange(reader,
+                             i + 1 < _job.bins.size()
+                               ? std::make_unique<BinReader>(_job.bins[i + 1])
+                               : nullptr)))
+      return false;
+
+  if (!loader.finish()) return false;
+  qInfo() << "Done";
+  return true;
+}
+
+/// Get a session with the target ready to write
+///
+/// If the target still answers, the session of the previous job gets reused.
+/// Otherwise, e.g. because the target got reset or unplugged, the port is
+/// opened and synced again. Either way the stub and baud rate are brought in
+/// line with the job. The MAC address is read for every job, the board might
+/// have been swapped without the port noticing.
+///
+/// \retval true  Session ready
+/// \retval false Error
+bool LoaderWorker::session() {
+  _phase = Metrics::Phase::Connect;
+  if (cancelled()) return false;
+  else if (_loader && _loader->ping())
+    qInfo().noquote() << "Still connected to" << _loader->portName();
+  else {
+    _loader = std::make_unique<Loader>(_port, [this] { return cancelled(); });
+    if (!_loader->open()) {
+      qCritical().noquote() << _loader->errorString();
+      _loader.reset();
+      return false;
+    }
+    qInfo().noquote() << "Connected to" << _loader->portName();
+  }
+  auto& loader{*_loader};
+  _mac = loader.readMac();
+  auto context{ProductionLog::context()};
+  context.port = loader.portName();
+  context.mac = _mac;
+  ProductionLog::setContext(context);
+
+  // Once running, the stub stays until the target gets reset
+  if (_job.stub && !loader.isStub()) {
+    _phase = Metrics::Phase::Stub;
+    if (!loader.runStub()) return false;
+    qInfo() << "Stub running";
+  }
+
+  // If left at "auto" switch to a higher baud rate
+  _phase = Metrics::Phase::Connect;
+  if (!loader.supportsBaudRate())
+    qInfo().noquote() << "Keeping baud rate of" << loader.portName();
+  else if (auto const baud_rate{_job.baud != "auto" ? _job.baud.toInt()
+                                : loader.isStub()   ? 921600
+                                                    : 460800};
+           baud_rate != loader.baudRate()) {
+    if (!loader.changeBaudRate(baud_rate)) return false;
+    qInfo() << "Changed baud rate to" << baud_rate;
+  }
+
+  return loader.spiAttach();
+}
+
+/// Check whether the board already has the binaries in flash
+///
+/// The history tells whether the last successful run on the board wrote the
+/// same binaries. Unless the history is trusted, the flash contents get
+/// compared with the binaries by MD5 as well, which is still much quicker than
+/// writing.
+///
+/// \param  loader  Loader
+/// \param  mac     MAC address of board
+/// \retval true    Board up to date
+/// \retval false   Board unknown, not up to date or error
+bool LoaderWorker::upToDate(Loader& loader, QString mac) {
+  if (_job.bins.isEmpty() || !History::get()->isOpen() || mac.isEmpty() ||
+      !History::get()->upToDate(mac, digest()))
+    return false;
+  else if (History::get()->isTrusted()) return true;
+  return std::all_of(
+    _job.bins.cbegin(), _job.bins.cend(), [&loader](BinSource const& bin) {
+      auto const flash{loader.flashMd5(bin.offset(), bin.size())};
+      auto const file{flash ? md5(bin, 0u, bin.size()) : std::nullopt};
+      return file && *flash == *file;
+    });
+}
+
+/// Get digest of binaries, calculated once per job
+///
+/// \return Digest of binaries
+QByteArray const& LoaderWorker::digest() {
+  if (_digest.isEmpty()) _digest = History::digest(_job.bins);
+  return _digest;
+}
+
+/// Write binary, resume after transmission errors
+///
+/// Whether a chunk gets written compressed or raw is up to CostModel. After a
+/// transmission error the chunks get read again, starting at the first sector
+/// which isn't in flash yet.
+///
+/// \param  loader  Loader
+/// \param  bin     Binary
+/// \param  reader  Reader of binary
+/// \retval true    Binary written
+/// \retval false   Error
+bool LoaderWorker::write(Loader& loader,
+                         BinSource const& bin,
+                         std::unique_ptr<BinReader> reader) {
+  auto const offset{bin.offset()};
+  uint32_t sent{};
+  QElapsedTimer timer;
+  timer.start();
+
+  for (auto retries{0};;) {
+    auto const chunk{reader->next()};
+    if (!chunk) return false;
+    else if (chunk->bytes.isEmpty()) break;
+
+    auto const size{static_cast<uint32_t>(chunk->bytes.size())};
+    CostModel::Link const link{.baud_rate = loader.baudRate(),
+                               .stub = loader.isStub()};
+    auto const step{CostModel::get()->predict(
+      offset + chunk->pos,
+      size,
+      static_cast<uint32_t>(chunk->deflated.size()),
+      link)};
+    QElapsedTimer chunk_timer;
+    chunk_timer.start();
+    if (step.compressed
+          ? loader.writeDeflated(offset + chunk->pos, size, chunk->deflated)
+          : loader.writeRaw(offset + chunk->pos, chunk->bytes)) {
+      CostModel::get()->observeWrite(
+        step, link, chunk_timer.elapsed() / 1000.0);
+      sent += step.compressed ? step.deflated_size : size;
+      continue;
+    } else if (++retries > max_retries || cancelled()) return false;
+
+    qWarning().noquote() << loader.errorString() << "after"
+                         << loader.ackedBlocks() << "blocks";
+    if (!resume(loader)) return false;
+
+    // Nothing new can be in flash if no block got acknowledged
+    auto verified{chunk->pos};
+    if (loader.ackedBlocks()) {
+      auto const prefix{verifiedPrefix(loader, bin, verified)};
+      if (!prefix) return false;
+      verified = *prefix;
+    }
+    if (verified == bin.size()) break;
+    qInfo().noquote() << QString{"Resuming at 0x%1"}.arg(
+      offset + verified, 8, 16, QChar{'0'});
+    reader = std::make_unique<BinReader>(bin, verified);
+  }
+
+  qInfo().noquote() << QString{"Wrote %1 bytes (%2 sent) at 0x%3 in %4s"}
+                         .arg(bin.size())
+                         .arg(sent)
+                         .arg(offset, 8, 16, QChar{'0'})
+                         .arg(timer.elapsed() / 1000.0, 0, 'f', 1);
+  return verify(loader, bin);
+}
+
+/// Compare flash contents with binary by MD5
+///
+/// \param  loader  Loader
+/// \param  bin     Binary
+/// \retval true    Flash contents match
+/// \retval false   Mismatch or error
+bool LoaderWorker::verify(Loader& loader, BinSource const& bin) {
+  QElapsedTimer timer;
+  timer.start();
+  auto const flash{loader.flashMd5(bin.offset(), bin.size())};
+  if (!flash) return false;
+  CostModel::get()->observeVerify(
+    bin.size(),
+    {.baud_rate = loader.baudRate(), .stub = loader.isStub()},
+    timer.elapsed() / 1000.0);
+  auto const file{md5(bin, 0u, bin.size())};
+  if (!file) return false;
+  else if (*flash != *file) {
+    qCritical().noquote() << QString{"Verifying 0x%1 failed"}.arg(
+      bin.offset(), 8, 16, QChar{'0'});
+    return false;
+  }
+  return true;
+}
+
+/// Reconnect after a transmission error
+///
+/// Each time the baud rate gets lowered a step, marginal links often work
+/// fine a little slower.
+///
+/// \param  loader  Loader
+/// \retval true    Reconnected
+/// \retval false   Error
+bool LoaderWorker::resume(Loader& loader) {
+  if (!loader.reconnect()) return false;
+  if (auto const baud_rate{loader.baudRate() / 2};
+      loader.supportsBaudRate() && baud_rate >= 115200) {
+    if (!loader.changeBaudRate(baud_rate)) return false;
+    qInfo() << "Lowered baud rate to" << baud_rate;
+  }
+  return true;
+}
+
+/// Find out how much of a binary is in flash already
+///
+/// The longest matching prefix gets searched sector by sector by comparing MD5
+/// digests. Once a prefix matches, only the sectors after it need to be
+/// compared, so each step reads less flash than the one before.
+///
+/// \param  loader        Loader
+/// \param  bin           Binary
+/// \param  verified      Size of prefix known to match
+/// \return Size          Size of matching prefix
+/// \return std::nullopt  Error
+std::optional<uint32_t> LoaderWorker::verifiedPrefix(Loader& loader,
+                                                     BinSource const& bin,
+                                                     uint32_t verified) {
+  auto const offset{bin.offset()};
+  auto const size{bin.size()};
+  auto lo{verified / sector_size};
+  auto hi{(size + sector_size - 1u) / sector_size};
+  while (lo < hi) {
+    auto const mid{lo + (hi - lo + 1u) / 2u};
+    auto const begin{lo * sector_size};
+    auto const end{std::min(mid * sector_size, size)};
+    auto const flash{loader.flashMd5(offset + begin, end - begin)};
+    auto const file{flash ? md5(bin, begin, end - begin) : std::nullopt};
+    if (!file) return std::nullopt;
+    else if (*flash == *file) lo = mid;
+    else hi = mid - 1u;
+  }
+  return std::min(lo * sector_size, size);
+}
+
+/// Save flash range to file
+///
+/// Blocks are written to the file as they arrive, so memory usage stays the
+/// same no matter how large the range is. If the file name ends with .gz, the
+/// data gets compressed on the fly.
+///
+/// \param  loader  Loader
+/// \retval true    Range saved
+/// \retval false   Error
+bool LoaderWorker::backup(Loader& loader) {
+  auto const& path{_job.backup->path};
+  auto size{_job.backup->size};
+
+  // Whole chip, size is taken from the bootloader currently on the target
+  if (!size) {
+    QByteArray header;
+    if (!loader.readFlash(0u, 16u, [&header](QByteArray const& block) {
+          header.append(block);
+          return true;
+        }))
+      return false;
+    if (auto const chip_size{flash_size(header)}) size = *chip_size;
+    else if (auto const bin_size{flash_size(_job.bins)}) size = *bin_size;
+    else {
+      qCritical() << "Unknown flash size, choose a range to backup";
+      return false;
+    }
+    if (_job.backup->offset >= size) {
+      qCritical() << "Backup offset exceeds flash size";
+      return false;
+    }
+    size -= _job.backup->offset;
+  }
+
+  std::unique_ptr<QIODevice> file;
+  if (path.endsWith(".gz", Qt::CaseInsensitive))
+    file = std::make_unique<QuaGzipFile>(path);
+  else file = std::make_unique<QFile>(path);
+  if (!file->open(QIODevice::WriteOnly)) {
+    qCritical().noquote() << "Can't open" << path;
+    return false;
+  }
+
+  QElapsedTimer timer;
+  timer.start();
+  auto const ok{loader.readFlash(
+    _job.backup->offset, size, [&file](QByteArray const& block) {
+      return file->write(block) == block.size();
+    })};
+  file->close();
+
+  // Don't leave incomplete backups behind
+  if (!ok) {
+    QFile::remove(path);
+    return false;
+  }
+
+  qInfo().noquote() << QString{"Saved %1 bytes at 0x%2 to %3 in %4s"}
+                         .arg(size)
+                         .arg(_job.backup->offset, 8, 16, QChar{'0'})
+                         .arg(QFileInfo{path}.fileName())
+                         .arg(timer.elapsed() / 1000.0, 0, 'f', 1);
+  return true;
+}
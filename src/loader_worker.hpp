@@ -0,0 +1,126 @@
+// Copyright (C) 2025 Vincent Hamp
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/// Pipelined flasher
+///
+/// \file   loader_worker.hpp
+/// \author Vincent Hamp
+/// \date   19/10/2026
+
+#pragma once
+
+#include <QObject>
+#include <atomic>
+#include <memory>
+#include <optional>
+#include "bin_source.hpp"
+#include "loader.hpp"
+#include "metrics.hpp"
+
+/// Worker which writes binaries using Loader
+///
+/// LoaderWorker is an alternative to EspFlasher. Contrary to EspFlasher it
+/// lives as long as its port is chosen. ComBox moves it to a
+/// [QThread](https://doc.qt.io/qt-6/qthread.html) of its own and queues jobs
+/// by calling LoaderWorker::start(), which run one after another on that
+/// thread. The connection to the target stays open between jobs at the
+/// negotiated baud rate, with the stub still running. A job first pings the
+/// target and only connects again if the target got reset or unplugged in the
+/// meantime, so consecutive jobs don't pay for syncing and changing the baud
+/// rate over and over. Jobs are stopped by LoaderWorker::cancel(), which only
+/// affects jobs queued before it got called.
+///
+/// Binaries get read from their archives and compressed chunk by chunk by a
+/// BinReader, which starts while the connection to the target is still being
+/// established and stays a few chunks ahead of writing. Optionally the esptool
+/// flasher stub gets uploaded first, see Loader::runStub(). With the stub
+/// running, a flash range can be saved to a file before writing, all within
+/// the same session.
+///
+/// Transmission errors while writing don't start the run over. The worker
+/// reconnects, optionally at a lower baud rate, compares the flash contents
+/// with the binary by MD5 to find out how far it got and continues from the
+/// first sector which doesn't match.
+///
+/// Each chunk gets written either compressed or raw, whichever CostModel
+/// predicts to be faster, and each binary is verified by MD5 afterwards. The
+/// measured times refine CostModel.
+///
+/// If a History is open, boards which got the same binaries last time are
+/// recognized by their MAC address and writing gets skipped. A per-board image
+/// of Provisioning doesn't count towards the history, its record only gets
+/// taken once the board is known to need writing.
+///
+/// The outcome of each run is recorded in Metrics, failures are counted by the
+/// phase the run was in.
+class LoaderWorker : public QObject {
+  Q_OBJECT
+
+public:
+  /// Flash range saved to a file before writing
+  ///
+  /// The file gets compressed if its name ends with .gz. A size of 0 saves
+  /// everything from offset to the end of the flash.
+  struct Backup {
+    QString path{};
+    uint32_t offset{};
+    uint32_t size{};
+  };
+
+  /// Options and binaries of a single run
+  struct Job {
+    QString baud{};
+    bool stub{};
+    QVector<BinSource> bins{};
+    std::optional<Backup> backup{};
+    bool provision{};
+  };
+
+  explicit LoaderWorker(QString port);
+
+  QString port() const;
+  void start(Job job);
+  void cancel();
+
+signals:
+  void finished();
+
+private:
+  bool cancelled() const;
+  void run(Job job);
+  bool flash();
+  bool session();
+  bool upToDate(Loader& loader, QString mac);
+  QByteArray const& digest();
+  bool write(Loader& loader,
+             BinSource const& bin,
+             std::unique_ptr<BinReader> reader);
+  bool verify(Loader& loader, BinSource const& bin);
+  bool resume(Loader& loader);
+  std::optional<uint32_t>
+  verifiedPrefix(Loader& loader, BinSource const& bin, uint32_t verified);
+  bool backup(Loader& loader);
+
+  QString const _port{};
+  std::unique_ptr<Loader> _loader{};
+  QString _mac{};
+  std::atomic<uint64_t> _queued{};
+  std::atomic<uint64_t> _cancelled{};
+  uint64_t _id{};
+  Job _job{};
+  QByteArray _digest{};
+  Metrics::Phase _phase{};
+  bool _up_to_date{};
+};
@@ -23,6 +23,7 @@
 #include <QContextMenuEvent>
 #include <QMenu>
 #include "message_handler.hpp"
+#include "trace.hpp"
 
 /// Connect QTextEdit to message handler
 Log::Log(QWidget* parent) : QTextEdit{parent} {
@@ -36,6 +37,7 @@ Log::Log(QWidget* parent) : QTextEdit{parent} {
 void Log::messageHandler(QtMsgType type,
                          QMessageLogContext const& context,
                          QString const& msg) {
+  ScopedTrace const trace{"Log::append"};
   switch (type) {
     case QtDebugMsg: append(msg); break;
     case QtInfoMsg: append(msg); break;
@@ -20,35 +20,194 @@
 /// \date   05/11/2024
 
 #include <QApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
 #include <QFile>
 #include <QFontDatabase>
+#include <QHostAddress>
+#include "first_paint_event_filter.hpp"
+#include "history.hpp"
 #include "main_window.hpp"
+#include "metrics.hpp"
+#include "mirror.hpp"
+#include "production_log.hpp"
+#include "provisioning.hpp"
+#include "trace.hpp"
 
 int main(int argc, char* argv[]) {
+  // Time of initialization steps
+  QElapsedTimer startup;
+  startup.start();
+  QStringList steps;
+  auto lap{[&startup, &steps, last = qint64{}](QString step) mutable {
+    auto const elapsed{startup.elapsed()};
+    steps.append(QString{"%1 %2ms"}.arg(step).arg(elapsed - last));
+    last = elapsed;
+  }};
+
   QCoreApplication::setApplicationName("OpenRemiseFlasher");
   QCoreApplication::setApplicationVersion(OPENREMISE_FLASHER_VERSION);
 
   // Create an application instance
   QApplication app{argc, argv};
+  lap("application");
+
+  // Station options
+  QCommandLineParser parser;
+  parser.addHelpOption();
+  parser.addVersionOption();
+  QCommandLineOption const metrics_port_option{
+    "metrics-port", "Serve metrics on <port> under /metrics.", "port"};
+  QCommandLineOption const metrics_address_option{
+    "metrics-address",
+    "Serve metrics on <address> instead of localhost only, e.g. 0.0.0.0.",
+    "address"};
+  QCommandLineOption const metrics_file_option{
+    "metrics-file", "Append metrics to <file> every 10s.", "file"};
+  QCommandLineOption const log_dir_option{
+    "log-dir", "Write production log to <dir>.", "dir"};
+  QCommandLineOption const provision_template_option{
+    "provision-template",
+    "Write NVS partition generated from <file> along with the firmware.",
+    "file"};
+  QCommandLineOption const provision_records_option{
+    "provision-records",
+    "Fill placeholders of provisioning template from <file>, one record per "
+    "board.",
+    "file"};
+  QCommandLineOption const trace_option{
+    "trace", "Write timing probes and stalls to trace <file>.", "file"};
+  QCommandLineOption const stall_threshold_option{
+    "stall-threshold",
+    "Report event loop stalls longer than <ms> milliseconds.",
+    "ms"};
+  QCommandLineOption const serve_mirror_option{
+    "serve-mirror",
+    "Serve downloaded firmware to other instances on <port>.",
+    "port"};
+  QCommandLineOption const firmware_url_option{
+    "firmware-url",
+    "Get latest firmware release from <url> (e.g. another instance's "
+    "http://<host>:<port>/releases/latest).",
+    "url"};
+  QCommandLineOption const watch_option{
+    "watch", "Load newest firmware archive dropped into <dir>.", "dir"};
+  QCommandLineOption const history_option{
+    "history",
+    "Record runs per board in <file> and skip boards already up to date.",
+    "file"};
+  QCommandLineOption const trust_history_option{
+    "trust-history",
+    "Skip boards up to date without comparing their flash contents."};
+  QCommandLineOption const benchmark_startup_option{
+    "benchmark-startup",
+    "Print time per initialization step and quit once the window is shown, "
+    "fail if that took longer than <ms> milliseconds.",
+    "ms"};
+  parser.addOptions({metrics_port_option,
+                     metrics_address_option,
+                     metrics_file_option,
+                     log_dir_option,
+                     provision_template_option,
+                     provision_records_option,
+                     trace_option,
+                     stall_threshold_option,
+                     serve_mirror_option,
+                     firmware_url_option,
+                     watch_option,
+                     history_option,
+                     trust_history_option,
+                     benchmark_startup_option});
+  parser.process(app);
+
+  // Metrics
+  if (parser.isSet(metrics_port_option) &&
+      !Metrics::get()->listen(
+        parser.value(metrics_port_option).toUShort(),
+        parser.isSet(metrics_address_option)
+          ? QHostAddress{parser.value(metrics_address_option)}
+          : QHostAddress{QHostAddress::LocalHost}))
+    return -1;
+  if (parser.isSet(metrics_file_option))
+    Metrics::get()->dump(parser.value(metrics_file_option));
+
+  // Production log
+  if (parser.isSet(log_dir_option) &&
+      !ProductionLog::get()->open(parser.value(log_dir_option)))
+    return -1;
+
+  // Provisioning
+  if (parser.isSet(provision_template_option) &&
+      !Provisioning::get()->open(parser.value(provision_template_option),
+                                 parser.value(provision_records_option)))
+    return -1;
+
+  // Tracing
+  if (parser.isSet(trace_option) &&
+      !Trace::get()->open(parser.value(trace_option)))
+    return -1;
+  if (parser.isSet(stall_threshold_option))
+    Trace::get()->watch(parser.value(stall_threshold_option).toInt());
+
+  // Mirror
+  if (parser.isSet(serve_mirror_option) &&
+      !Mirror::get()->listen(parser.value(serve_mirror_option).toUShort()))
+    return -1;
+
+  // History
+  if (parser.isSet(history_option) &&
+      !History::get()->open(parser.value(history_option),
+                            parser.isSet(trust_history_option)))
+    return -1;
+
+  lap("options");
 
   // Initialize resources
   Q_INIT_RESOURCE(qtbreeze_stylesheets);
 
   /// \bug Adding GlacialIndifference does not work on Windows
-  if (QFontDatabase::addApplicationFont(
-        ":/fonts/GlacialIndifference-Regular.otf") == -1)
-    return -1;
-  QFont font{"GlacialIndifference"};
-  font.setPointSize(10);
-  app.setFont(font);
+  {
+    ScopedTrace const trace{"main::font"};
+    if (QFontDatabase::addApplicationFont(
+          ":/fonts/GlacialIndifference-Regular.otf") == -1)
+      return -1;
+    QFont font{"GlacialIndifference"};
+    font.setPointSize(10);
+    app.setFont(font);
+  }
+  lap("font");
 
   // Apply breeze stylesheet
-  QFile file{":/light/stylesheet.qss"};
-  file.open(QFile::ReadOnly | QFile::Text);
-  QTextStream stream{&file};
-  app.setStyleSheet(stream.readAll());
+  {
+    ScopedTrace const trace{"main::stylesheet"};
+    QFile file{":/light/stylesheet.qss"};
+    file.open(QFile::ReadOnly | QFile::Text);
+    QTextStream stream{&file};
+    app.setStyleSheet(stream.readAll());
+  }
+  lap("stylesheet");
 
-  MainWindow w{};
+  MainWindow w{parser.isSet(firmware_url_option)
+                 ? QUrl{parser.value(firmware_url_option)}
+                 : QUrl{OPENREMISE_FIRMWARE_URL}};
+  if (parser.isSet(watch_option)) w.watch(parser.value(watch_option));
+  lap("window");
   w.show();
+  lap("show");
+
+  // Quit once the first frame is drawn
+  if (parser.isSet(benchmark_startup_option)) {
+    auto first_paint{new FirstPaintEventFilter{&w}};
+    w.installEventFilter(first_paint);
+    QObject::connect(first_paint, &FirstPaintEventFilter::painted, [&] {
+      lap("first frame");
+      auto const elapsed{startup.elapsed()};
+      auto const budget{parser.value(benchmark_startup_option).toLongLong()};
+      QTextStream{stdout} << steps.join('\n') << "\ntotal " << elapsed
+                          << "ms\n";
+      QCoreApplication::exit(elapsed <= budget ? 0 : -1);
+    });
+  }
+
   return app.exec();
 }
@@ -20,9 +20,8 @@
 /// \date   05/11/2024
 
 #include "main_window.hpp"
-#include <JlCompress.h>
 #include <QApplication>
-#include <QDirIterator>
+#include <QDir>
 #include <QFileDialog>
 #include <QJsonArray>
 #include <QJsonDocument>
@@ -30,11 +29,21 @@
 #include <QLabel>
 #include <QMessageBox>
 #include <QNetworkReply>
+#include <QSaveFile>
 #include <QTemporaryDir>
 #include <QVBoxLayout>
+#include "archive.hpp"
+#include "first_paint_event_filter.hpp"
+#include "mirror.hpp"
+#include "trace.hpp"
+#include "watch_folder.hpp"
 
 /// Add menu and toolbar
-MainWindow::MainWindow() {
+///
+/// \param  firmware_url  URL of latest firmware release metadata
+MainWindow::MainWindow(QUrl firmware_url) : _firmware_url{firmware_url} {
+  ScopedTrace const trace{"MainWindow::MainWindow"};
+
   // Initial size
   resize(480, 640);
 
@@ -43,10 +52,9 @@ MainWindow::MainWindow() {
   _toolbar->setFloatable(false);
   _toolbar->setMovable(false);
 
-  // Add network drive action
-  QIcon const network_drive_icon{":/light/network_drive.svg"};
-  auto network_drive_act{
-    new QAction{network_drive_icon, "Download latest firmware", this}};
+  // Add network drive action, icons are loaded later
+  auto network_drive_act{new QAction{"Download latest firmware", this}};
+  network_drive_act->setData(":/light/network_drive.svg");
   connect(network_drive_act,
           &QAction::triggered,
           this,
@@ -54,8 +62,8 @@ MainWindow::MainWindow() {
   _toolbar->addAction(network_drive_act);
 
   // Add hard drive action
-  QIcon const hard_drive_icon{":/light/hard_drive.svg"};
-  auto hard_drive_act{new QAction{hard_drive_icon, "Open firmware", this}};
+  auto hard_drive_act{new QAction{"Open firmware", this}};
+  hard_drive_act->setData(":/light/hard_drive.svg");
   connect(hard_drive_act,
           &QAction::triggered,
           this,
@@ -63,8 +71,8 @@ MainWindow::MainWindow() {
   _toolbar->addAction(hard_drive_act);
 
   // Help action
-  QIcon const about_icon{":/light/dialog_help.svg"};
-  auto about_act{new QAction{about_icon, "&About", this}};
+  auto about_act{new QAction{"&About", this}};
+  about_act->setData(":/light/dialog_help.svg");
   connect(about_act, &QAction::triggered, this, &MainWindow::about);
   _toolbar->addAction(about_act);
 
@@ -80,12 +88,13 @@ MainWindow::MainWindow() {
 
   connect(this, &MainWindow::binaries, _com_box, &ComBox::binaries);
 
-  // Workaround for WIN32, otherwise it throws self-signed and untrusted at us
-  connect(_network_manager,
-          &QNetworkAccessManager::sslErrors,
-          [](QNetworkReply* reply, QList<QSslError> const&) {
-            reply->ignoreSslErrors();
-          });
+  // Load icons once the window is shown
+  auto first_paint{new FirstPaintEventFilter{this}};
+  installEventFilter(first_paint);
+  connect(first_paint,
+          &FirstPaintEventFilter::painted,
+          this,
+          &MainWindow::loadIcons);
 }
 
 /// Open file dialog, get .zip archive path
@@ -107,48 +116,14 @@ void MainWindow::addArchiveFromHardDrive() {
 ///
 /// \param  ar_path Zip archive path
 void MainWindow::addArchiveFromHardDrive(QString ar_path) {
-  // Create temporary directory
-  QTemporaryDir temp_dir;
-  if (!temp_dir.isValid()) {
-    qCritical().noquote() << temp_dir.errorString();
-    return;
-  }
-
-  // Extract files to temporary directory, then add it
-  JlCompress::extractDir(ar_path, temp_dir.path());
-
-  QDirIterator it{temp_dir.path(),
-                  QStringList() << "flasher_args.json",
-                  QDir::Files,
-                  QDirIterator::Subdirectories};
-  if (!it.hasNext()) {
-    qCritical() << "No OpenRemise firmware found";
-    return;
-  }
-  auto const json_path{it.next()};
-
-  // Gather binaries
-  QVector<Bin> bins{};
-  QFile json{json_path};
-  json.open(QIODevice::ReadOnly | QIODevice::Text);
-  QJsonDocument const doc{QJsonDocument::fromJson(json.readAll())};
-  QJsonObject const flash_files{doc["flash_files"].toObject()};
-  for (auto const& offset : flash_files.keys()) {
-    auto const bin_path{QFileInfo{json_path}.dir().filePath(
-      flash_files.value(offset).toString())};
-    QFile bytes{bin_path};
-    bytes.open(QIODevice::ReadOnly);
-    bins.push_back(
-      {.offset = offset.toUInt(nullptr, 0), .bytes = bytes.readAll()});
-  }
-
-  emit binaries(bins);
+  ScopedTrace const trace{"MainWindow::addArchiveFromHardDrive"};
+  if (auto const bins{read_archive(ar_path)}; !bins.isEmpty())
+    emit binaries(bins);
 }
 
 /// Query GitHub REST API for latest release of firmware
 void MainWindow::addArchiveFromNetworkDrive() {
-  auto const reply{
-    _network_manager->get(QNetworkRequest{QUrl{OPENREMISE_FIRMWARE_URL}})};
+  auto const reply{networkManager()->get(QNetworkRequest{_firmware_url})};
 
   connect(reply, &QNetworkReply::finished, this, [this, reply] {
     if (reply->error()) {
@@ -156,6 +131,9 @@ void MainWindow::addArchiveFromNetworkDrive() {
       return;
     }
 
+    // Peek, the metadata is parsed below
+    Mirror::get()->release(reply->peek(reply->bytesAvailable()));
+
     // Qt's JSON interface is beyond my comprehension. Just don't touch this.
     // Just... don't. Don't change a const, don't change the assign... just keep
     // it the way it is.
@@ -178,7 +156,7 @@ void MainWindow::addArchiveFromNetworkDrive() {
 /// \param  browser_download_url  URL of latest firmware release
 void MainWindow::addArchiveFromNetworkDrive(QString browser_download_url) {
   auto const reply{
-    _network_manager->get(QNetworkRequest{QUrl{browser_download_url}})};
+    networkManager()->get(QNetworkRequest{QUrl{browser_download_url}})};
 
   // Show download progress
   connect(reply, &QNetworkReply::downloadProgress, [](qint64 ist, qint64 max) {
@@ -188,24 +166,54 @@ void MainWindow::addArchiveFromNetworkDrive(QString browser_download_url) {
   });
 
   connect(reply, &QNetworkReply::finished, this, [=, this] {
+    ScopedTrace const trace{"MainWindow::addArchiveFromNetworkDrive"};
     qInfo().noquote() << "Done";
 
-    // Create temporary directory
-    QTemporaryDir temp_dir;
-    if (!temp_dir.isValid()) {
-      qCritical().noquote() << temp_dir.errorString();
+    // Binaries are read from the archive on demand, so keep it until we quit
+    if (!_download_dir) _download_dir = std::make_unique<QTemporaryDir>();
+    if (!_download_dir->isValid()) {
+      qCritical().noquote() << _download_dir->errorString();
       return;
     }
 
-    // Download .zip archive
-    QFile file(temp_dir.filePath(QFileInfo{browser_download_url}.fileName()));
+    // Download .zip archive, replace the previous one only once complete
+    auto const bytes{reply->readAll()};
+    QSaveFile file(
+      _download_dir->filePath(QFileInfo{browser_download_url}.fileName()));
     file.open(QIODevice::WriteOnly);
-    file.write(reply->readAll());
-    file.close();
-    addArchiveFromHardDrive(QFileInfo{file}.absoluteFilePath());
+    file.write(bytes);
+    file.commit();
+    Mirror::get()->asset(QFileInfo{browser_download_url}.fileName(), bytes);
+    addArchiveFromHardDrive(QFileInfo{file.fileName()}.absoluteFilePath());
   });
 }
 
+/// Get network access manager, created on first use
+///
+/// \return Network access manager
+QNetworkAccessManager* MainWindow::networkManager() {
+  if (_network_manager) return _network_manager;
+  _network_manager = new QNetworkAccessManager{this};
+
+  // Workaround for WIN32, otherwise it throws self-signed and untrusted at us
+  connect(_network_manager,
+          &QNetworkAccessManager::sslErrors,
+          [](QNetworkReply* reply, QList<QSslError> const&) {
+            reply->ignoreSslErrors();
+          });
+
+  return _network_manager;
+}
+
+/// Load newest archive of folder whenever one arrives
+///
+/// \param  path  Folder
+void MainWindow::watch(QString path) {
+  auto watch_folder{new WatchFolder{path, this}};
+  connect(watch_folder, &WatchFolder::binaries, this, &MainWindow::binaries);
+  qInfo().noquote() << "Watching" << QDir::toNativeSeparators(path);
+}
+
 /// About message box
 void MainWindow::about() {
   QMessageBox about;
@@ -220,3 +228,11 @@ void MainWindow::about() {
   about.show();
   about.exec();
 }
+
+/// Load icons of toolbar and ComBox
+void MainWindow::loadIcons() {
+  ScopedTrace const trace{"MainWindow::loadIcons"};
+  for (auto act : _toolbar->actions())
+    act->setIcon(QIcon{act->data().toString()});
+  _com_box->loadIcons();
+}
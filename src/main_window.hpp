@@ -23,7 +23,10 @@
 
 #include <QMainWindow>
 #include <QNetworkAccessManager>
+#include <QTemporaryDir>
 #include <QToolBar>
+#include <QUrl>
+#include <memory>
 #include "com_box.hpp"
 #include "log.hpp"
 
@@ -37,27 +40,39 @@
 ///
 /// This class also contains functions to open firmware .zip files locally
 /// (MainWindow::addArchiveFromHardDrive()) or from the Internet
-/// (MainWindow::addArchiveFromNetworkDrive()).
+/// (MainWindow::addArchiveFromNetworkDrive()). Downloads get handed to Mirror,
+/// which serves them to other instances if enabled. Alternatively a folder can
+/// be watched for new archives (MainWindow::watch()).
+///
+/// Anything not needed to show the window is deferred. Icons get loaded once
+/// the first frame has been drawn, the network access manager only on the
+/// first download.
 class MainWindow : public QMainWindow {
   Q_OBJECT
 
 public:
-  MainWindow();
+  explicit MainWindow(QUrl firmware_url = QUrl{OPENREMISE_FIRMWARE_URL});
+
+  void watch(QString path);
 
 private slots:
   void about();
+  void loadIcons();
 
 signals:
-  void binaries(QVector<Bin> bins);
+  void binaries(QVector<BinSource> bins);
 
 private:
   void addArchiveFromHardDrive();
   void addArchiveFromHardDrive(QString ar_path);
   void addArchiveFromNetworkDrive();
   void addArchiveFromNetworkDrive(QString browser_download_url);
+  QNetworkAccessManager* networkManager();
 
+  QUrl _firmware_url{};
   QToolBar* _toolbar{addToolBar("")};
-  QNetworkAccessManager* _network_manager{new QNetworkAccessManager};
+  QNetworkAccessManager* _network_manager{};
+  std::unique_ptr<QTemporaryDir> _download_dir{};
   ComBox* _com_box{new ComBox};
   Log* _log{new Log};
 };
@@ -0,0 +1,210 @@
+// Copyright (C) 2025 Vincent Hamp
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/// Station metrics
+///
+/// \file   metrics.cpp
+/// \author Vincent Hamp
+/// \date   19/10/2026
+
+#include "metrics.hpp"
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDebug>
+#include <QFile>
+#include <QTimer>
+#include <algorithm>
+#include "http_server.hpp"
+
+namespace {
+
+/// Label values of Metrics::Phase
+inline constexpr std::array phase_names{
+  "connect", "stub", "read", "write", "flash"};
+static_assert(phase_names.size() ==
+              static_cast<size_t>(Metrics::Phase::Count));
+
+/// Add a counter in Prometheus text format
+///
+/// \param  name  Metric name
+/// \param  help  Description
+/// \param  value Value
+/// \return Counter in Prometheus text format
+QByteArray counter(QByteArray const& name,
+                   QByteArray const& help,
+                   uint64_t value) {
+  return "# HELP " + name + ' ' + help + "\n# TYPE " + name + " counter\n" +
+         name + ' ' + QByteArray::number(value) + '\n';
+}
+
+/// Shift rotated files up by one and rotate current file
+///
+/// \param  path      File path
+/// \param  max_files Number of rotated files kept
+void rotate(QString const& path, int max_files) {
+  QFile::remove(path + '.' + QString::number(max_files));
+  for (auto i{max_files - 1}; i > 0; --i)
+    QFile::rename(path + '.' + QString::number(i),
+                  path + '.' + QString::number(i + 1));
+  QFile::rename(path, path + ".1");
+}
+
+} // namespace
+
+/// Count observation
+///
+/// \param  seconds Observation in seconds
+template<size_t N>
+void Metrics::Histogram<N>::observe(double seconds) {
+  auto const i{static_cast<size_t>(
+    std::ranges::lower_bound(bounds, seconds) - bounds.begin())};
+  counts[i].fetch_add(1u, std::memory_order_relaxed);
+  sum_us.fetch_add(static_cast<uint64_t>(seconds * 1e6),
+                   std::memory_order_relaxed);
+}
+
+/// Get histogram in Prometheus text format
+///
+/// \param  name  Metric name
+/// \param  help  Description
+/// \return Histogram in Prometheus text format
+template<size_t N>
+QByteArray Metrics::Histogram<N>::prometheus(QByteArray const& name,
+                                             QByteArray const& help) const {
+  auto str{"# HELP " + name + ' ' + help + "\n# TYPE " + name +
+           " histogram\n"};
+  uint64_t cumulative{};
+  for (size_t i{}; i < N; ++i) {
+    cumulative += counts[i].load(std::memory_order_relaxed);
+    str += name + "_bucket{le=\"" + QByteArray::number(bounds[i]) + "\"} " +
+           QByteArray::number(cumulative) + '\n';
+  }
+  cumulative += counts[N].load(std::memory_order_relaxed);
+  str += name + "_bucket{le=\"+Inf\"} " + QByteArray::number(cumulative) +
+         '\n';
+  str += name + "_sum " +
+         QByteArray::number(sum_us.load(std::memory_order_relaxed) / 1e6) +
+         '\n';
+  str += name + "_count " + QByteArray::number(cumulative) + '\n';
+  return str;
+}
+
+/// Singleton pattern
+Metrics* Metrics::get() {
+  static Metrics metrics;
+  return &metrics;
+}
+
+/// Record time a run was waiting to be started
+///
+/// \param  seconds Queue wait in seconds
+void Metrics::queued(double seconds) { _queue_wait.observe(seconds); }
+
+/// Record successful run
+///
+/// \param  bytes   Bytes written
+/// \param  seconds Flash time in seconds
+void Metrics::flashed(qint64 bytes, double seconds) {
+  _boards_flashed.fetch_add(1u, std::memory_order_relaxed);
+  _bytes_written.fetch_add(static_cast<uint64_t>(bytes),
+                           std::memory_order_relaxed);
+  _flash_time.observe(seconds);
+}
+
+/// Record failed run
+///
+/// \param  phase Phase in which the run failed
+void Metrics::failed(Phase phase) {
+  _failures[static_cast<size_t>(phase)].fetch_add(1u,
+                                                  std::memory_order_relaxed);
+}
+
+/// Get metrics in Prometheus text format
+///
+/// \return Metrics in Prometheus text format
+QByteArray Metrics::prometheus() const {
+  auto str{counter("flasher_boards_flashed_total",
+                   "Number of boards flashed successfully",
+                   _boards_flashed.load(std::memory_order_relaxed))};
+  str += counter("flasher_bytes_written_total",
+                 "Number of uncompressed bytes written",
+                 _bytes_written.load(std::memory_order_relaxed));
+  str += "# HELP flasher_failures_total Number of failed runs by phase\n"
+         "# TYPE flasher_failures_total counter\n";
+  for (size_t i{}; i < phase_names.size(); ++i)
+    str += QByteArray{"flasher_failures_total{phase=\""} + phase_names[i] +
+           "\"} " +
+           QByteArray::number(_failures[i].load(std::memory_order_relaxed)) +
+           '\n';
+  str += _flash_time.prometheus("flasher_flash_duration_seconds",
+                                "Time it took to flash a board");
+  str += _queue_wait.prometheus("flasher_queue_wait_seconds",
+                                "Time a run was waiting to be started");
+  return str;
+}
+
+/// Serve metrics on a HTTP endpoint
+///
+/// \param  port    TCP port
+/// \param  address Address to bind to
+/// \retval true    Listening
+/// \retval false   Error
+bool Metrics::listen(quint16 port, QHostAddress const& address) {
+  auto server{new HttpServer{[this](HttpServer::Request const& req) {
+                               if (req.path != "/metrics")
+                                 return HttpServer::Response{.status = 404};
+                               return HttpServer::Response{
+                                 .content_type = "text/plain; version=0.0.4",
+                                 .body = prometheus()};
+                             },
+                             qApp}};
+  if (!server->listen(address, port)) {
+    qCritical().noquote() << server->errorString();
+    delete server;
+    return false;
+  }
+  return true;
+}
+
+/// Periodically append metrics to a rolling file
+///
+/// Each snapshot starts with a comment containing its time. Once the file
+/// exceeds max_size it gets renamed to `<path>.1`, older files move up to
+/// `<path>.<max_files>` and the oldest one gets dropped.
+///
+/// \param  path      File path
+/// \param  interval  Interval in ms
+/// \param  max_size  Size in bytes after which the file gets rotated
+/// \param  max_files Number of rotated files kept
+void Metrics::dump(QString path, int interval, qint64 max_size, int max_files) {
+  auto const write{[this, path, max_size, max_files] {
+    if (QFile file{path}; file.open(QIODevice::Append)) {
+      file.write("# time " +
+                 QDateTime::currentDateTimeUtc()
+                   .toString(Qt::ISODate)
+                   .toLatin1() +
+                 '\n' + prometheus());
+      if (file.size() < max_size) return;
+    } else {
+      qCritical().noquote() << "Can't write" << path;
+      return;
+    }
+    rotate(path, max_files);
+  }};
+  auto timer{new QTimer{qApp}};
+  QObject::connect(timer, &QTimer::timeout, write);
+  QObject::connect(qApp, &QCoreApplication::aboutToQuit, write);
+  timer->start(interval);
+}
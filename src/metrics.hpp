@@ -0,0 +1,88 @@
+// Copyright (C) 2025 Vincent Hamp
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/// Station metrics
+///
+/// \file   metrics.hpp
+/// \author Vincent Hamp
+/// \date   19/10/2026
+
+#pragma once
+
+#include <QByteArray>
+#include <QHostAddress>
+#include <QString>
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+/// Counters and histograms of flash runs
+///
+/// Metrics is a singleton which counts boards flashed, failures by phase and
+/// bytes written and records flash and queue wait times as histograms. All
+/// updates are relaxed atomic operations and happen once per run or phase, so
+/// they may be called from any thread without slowing flashing down.
+///
+/// The metrics can either be served in Prometheus
+/// [text format](https://prometheus.io/docs/instrumenting/exposition_formats)
+/// by calling Metrics::listen() or periodically be appended to a rolling file
+/// by calling Metrics::dump(). Both must be called from the main thread. Unless
+/// told otherwise, Metrics::listen() only accepts local connections.
+class Metrics {
+public:
+  /// Phases in which a run can fail
+  enum class Phase : uint8_t { Connect, Stub, Read, Write, Flash, Count };
+
+  static Metrics* get();
+
+  void queued(double seconds);
+  void flashed(qint64 bytes, double seconds);
+  void failed(Phase phase);
+
+  QByteArray prometheus() const;
+  bool listen(quint16 port,
+              QHostAddress const& address = QHostAddress::LocalHost);
+  void dump(QString path,
+            int interval = 10000,
+            qint64 max_size = 1024 * 1024,
+            int max_files = 5);
+
+private:
+  /// Histogram with fixed upper bounds in seconds
+  template<size_t N>
+  struct Histogram {
+    void observe(double seconds);
+    QByteArray prometheus(QByteArray const& name,
+                          QByteArray const& help) const;
+
+    std::array<double, N> bounds{};
+    std::array<std::atomic<uint64_t>, N + 1u> counts{};
+    std::atomic<uint64_t> sum_us{};
+  };
+
+  Metrics() = default;
+  Metrics(Metrics const&) = delete;
+  Metrics(Metrics&&) = delete;
+  Metrics& operator=(Metrics const&) = delete;
+  Metrics& operator=(Metrics&&) = delete;
+
+  std::atomic<uint64_t> _boards_flashed{};
+  std::atomic<uint64_t> _bytes_written{};
+  std::array<std::atomic<uint64_t>, static_cast<size_t>(Phase::Count)>
+    _failures{};
+  Histogram<8u> _flash_time{.bounds = {5, 10, 20, 30, 45, 60, 120, 300}};
+  Histogram<8u> _queue_wait{
+    .bounds = {0.001, 0.005, 0.01, 0.05, 0.1, 0.5, 1, 5}};
+};
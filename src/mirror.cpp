@@ -0,0 +1,226 @@
+// Copyright (C) 2025 Vincent Hamp
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/// Local firmware mirror
+///
+/// \file   mirror.cpp
+/// \author Vincent Hamp
+/// \date   19/10/2026
+
+#include "mirror.hpp"
+#include <QCoreApplication>
+#include <QDebug>
+#include <QFile>
+#include <QFileInfo>
+#include <QHostAddress>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QStringList>
+#include <QUrl>
+#include <utility>
+#include "http_server.hpp"
+
+namespace {
+
+/// Name of cached release metadata
+inline constexpr auto release_file_name{"latest.json"};
+
+/// Check whether asset name is safe to use as file name
+///
+/// \param  name  Asset name
+/// \retval true  Safe
+/// \retval false Name contains path separators or starts with a dot
+bool valid_asset_name(QString const& name) {
+  return !name.isEmpty() && !name.startsWith('.') && !name.contains('/') &&
+         !name.contains('\\');
+}
+
+/// Rewrite all download URLs to point at mirror
+///
+/// \param  value JSON value
+/// \param  base  Base URL of assets on mirror
+/// \return JSON value with rewritten URLs
+QJsonValue rewrite(QJsonValue value, QString const& base) {
+  if (value.isArray()) {
+    auto arr{value.toArray()};
+    for (auto i{0}; i < arr.size(); ++i) arr[i] = rewrite(arr[i], base);
+    return arr;
+  } else if (value.isObject()) {
+    auto obj{value.toObject()};
+    for (auto it{obj.begin()}; it != obj.end(); ++it)
+      if (it.key() == "browser_download_url")
+        it.value() =
+          base + QString::fromLatin1(QUrl::toPercentEncoding(
+                   QFileInfo{QUrl{it.value().toString()}.path()}.fileName()));
+      else it.value() = rewrite(it.value(), base);
+    return obj;
+  }
+  return value;
+}
+
+/// Collect file names of all download URLs
+///
+/// \param  value JSON value
+/// \param  names File names
+void collect_asset_names(QJsonValue const& value, QStringList& names) {
+  if (value.isArray())
+    for (auto const& v : value.toArray()) collect_asset_names(v, names);
+  else if (value.isObject()) {
+    auto const obj{value.toObject()};
+    for (auto it{obj.begin()}; it != obj.end(); ++it)
+      if (it.key() == "browser_download_url")
+        names.push_back(
+          QFileInfo{QUrl{it.value().toString()}.path()}.fileName());
+      else collect_asset_names(it.value(), names);
+  }
+}
+
+/// Get file names of all assets of release
+///
+/// \param  json  Release metadata
+/// \return File names
+QStringList asset_names(QByteArray const& json) {
+  auto const doc{QJsonDocument::fromJson(json)};
+  QStringList names;
+  collect_asset_names(
+    doc.isArray() ? QJsonValue{doc.array()} : QJsonValue{doc.object()}, names);
+  return names;
+}
+
+/// Save file atomically
+///
+/// \param  path  File path
+/// \param  bytes Content
+void save(QString path, QByteArray const& bytes) {
+  QSaveFile file{path};
+  if (!file.open(QIODevice::WriteOnly) || file.write(bytes) < 0 ||
+      !file.commit())
+    qCritical().noquote() << "Can't write" << path;
+}
+
+} // namespace
+
+/// Singleton pattern
+Mirror* Mirror::get() {
+  static Mirror mirror;
+  return &mirror;
+}
+
+/// Serve cached release on a local HTTP endpoint
+///
+/// \param  port  TCP port
+/// \retval true  Listening
+/// \retval false Error
+bool Mirror::listen(quint16 port) {
+  _dir.setPath(
+    QStandardPaths::writableLocation(QStandardPaths::CacheLocation) +
+    "/mirror");
+  if (!_dir.mkpath(".")) {
+    qCritical().noquote() << "Can't create" << _dir.path();
+    return false;
+  }
+
+  // Continue serving last release
+  if (QFile file{_dir.filePath(release_file_name)};
+      file.open(QIODevice::ReadOnly))
+    _release = file.readAll();
+
+  auto server{new HttpServer{
+    [this](HttpServer::Request const& req) {
+      if (req.path == "/releases/latest") {
+        auto const body{latest(req.headers.value("host"))};
+        if (body.isEmpty()) return HttpServer::Response{.status = 503};
+        return HttpServer::Response{.content_type = "application/json",
+                                    .body = body};
+      } else if (req.path.startsWith("/assets/")) {
+        if (auto const body{cached(req.path.mid(8))}; !body.isEmpty())
+          return HttpServer::Response{.content_type = "application/zip",
+                                      .body = body};
+      }
+      return HttpServer::Response{.status = 404};
+    },
+    qApp}};
+  if (!server->listen(QHostAddress::Any, port)) {
+    qCritical().noquote() << server->errorString();
+    delete server;
+    return false;
+  }
+
+  _listening = true;
+  return true;
+}
+
+/// Stage release metadata
+///
+/// The metadata only gets served once Mirror::asset() saved one of its assets.
+///
+/// \param  json  Release metadata as returned by GitHub
+void Mirror::release(QByteArray const& json) {
+  if (!_listening || QJsonDocument::fromJson(json).isNull()) return;
+  _staged = json == _release ? QByteArray{} : json;
+}
+
+/// Cache release asset
+///
+/// Assets of previous releases get removed. If the asset belongs to the staged
+/// release metadata, the metadata gets published as well.
+///
+/// \param  name  Asset name
+/// \param  bytes Asset
+void Mirror::asset(QString name, QByteArray const& bytes) {
+  if (!_listening || !valid_asset_name(name)) return;
+  for (auto const& file_name : _dir.entryList(QDir::Files))
+    if (file_name != release_file_name && file_name != name)
+      _dir.remove(file_name);
+  save(_dir.filePath(name), bytes);
+  _assets = {{name, bytes}};
+  if (asset_names(_staged).contains(name)) {
+    _release = std::exchange(_staged, {});
+    save(_dir.filePath(release_file_name), _release);
+  }
+  qInfo().noquote() << "Mirroring" << name;
+}
+
+/// Get release asset, read from disk on first use
+///
+/// \param  name  Asset name
+/// \return Asset or empty byte array if none is cached
+QByteArray Mirror::cached(QString const& name) {
+  if (!valid_asset_name(name)) return {};
+  else if (auto const it{_assets.constFind(name)}; it != _assets.cend())
+    return *it;
+  QFile file{_dir.filePath(name)};
+  if (!file.open(QIODevice::ReadOnly)) return {};
+  return _assets[name] = file.readAll();
+}
+
+/// Get release metadata with download URLs pointing at mirror
+///
+/// \param  host  Value of host header sent by client
+/// \return Release metadata or empty byte array if none is cached
+QByteArray Mirror::latest(QByteArray const& host) const {
+  if (_release.isEmpty() || host.isEmpty()) return {};
+  auto const base{"http://" + QString::fromLatin1(host) + "/assets/"};
+  auto const doc{QJsonDocument::fromJson(_release)};
+  auto const value{
+    rewrite(doc.isArray() ? QJsonValue{doc.array()} : QJsonValue{doc.object()},
+            base)};
+  return (value.isArray() ? QJsonDocument{value.toArray()}
+                          : QJsonDocument{value.toObject()})
+    .toJson(QJsonDocument::Compact);
+}
@@ -0,0 +1,69 @@
+// Copyright (C) 2025 Vincent Hamp
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/// Local firmware mirror
+///
+/// \file   mirror.hpp
+/// \author Vincent Hamp
+/// \date   19/10/2026
+
+#pragma once
+
+#include <QByteArray>
+#include <QDir>
+#include <QHash>
+#include <QString>
+
+/// Local HTTP mirror of the latest firmware release
+///
+/// Mirror is a singleton which serves the release metadata and the firmware
+/// archive last downloaded by MainWindow to other Flasher instances on the
+/// LAN. It mimics the part of the
+/// [GitHub REST API](https://docs.github.com/en/rest/releases/releases#get-the-latest-release)
+/// Flasher uses, so other instances only need to be pointed at
+/// `http://<host>:<port>/releases/latest` with `--firmware-url`.
+///
+/// Each `browser_download_url` in the metadata gets rewritten to point at
+/// `/assets/<name>` on the mirror itself, using the host the client connected
+/// to. Metadata and archives are cached on disk, so a restarted mirror keeps
+/// serving the last release without going online first. Archives are read
+/// from disk only once and then served from memory. Only the archive of the
+/// latest release is kept. New metadata is held back until one of its assets
+/// has been saved, so the mirror never advertises an archive it can't serve.
+/// All calls must be made from the main thread.
+class Mirror {
+public:
+  static Mirror* get();
+
+  bool listen(quint16 port);
+  void release(QByteArray const& json);
+  void asset(QString name, QByteArray const& bytes);
+
+private:
+  Mirror() = default;
+  Mirror(Mirror const&) = delete;
+  Mirror(Mirror&&) = delete;
+  Mirror& operator=(Mirror const&) = delete;
+  Mirror& operator=(Mirror&&) = delete;
+
+  QByteArray latest(QByteArray const& host) const;
+  QByteArray cached(QString const& name);
+
+  QDir _dir{};
+  QByteArray _release{};
+  QByteArray _staged{};
+  QHash<QString, QByteArray> _assets{};
+  bool _listening{};
+};
@@ -0,0 +1,378 @@
+// Copyright (C) 2025 Vincent Hamp
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/// NVS partition image
+///
+/// \file   nvs.cpp
+/// \author Vincent Hamp
+/// \date   19/10/2026
+
+#include "nvs.hpp"
+#include <QDebug>
+#include <QHash>
+#include <QtEndian>
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <limits>
+#include <optional>
+#include <type_traits>
+
+namespace {
+
+/// Entry types
+enum Type : uint8_t {
+  U8 = 0x01u,
+  I8 = 0x11u,
+  U16 = 0x02u,
+  I16 = 0x12u,
+  U32 = 0x04u,
+  I32 = 0x14u,
+  U64 = 0x08u,
+  I64 = 0x18u,
+  Sz = 0x21u,
+  BlobData = 0x42u,
+  BlobIdx = 0x48u,
+};
+
+/// Page layout
+inline constexpr qsizetype page_size{4096};
+inline constexpr qsizetype bitmap_offset{32};
+inline constexpr qsizetype first_entry_offset{64};
+inline constexpr qsizetype entry_size{32};
+inline constexpr auto entries_per_page{126};
+
+/// Page states
+inline constexpr uint32_t page_active{0xFFFFFFFEu};
+inline constexpr uint32_t page_full{0xFFFFFFFCu};
+
+/// Page format version 2, which allows blobs to span multiple pages
+inline constexpr uint8_t page_version{0xFEu};
+
+/// Maximum sizes of keys (without NUL) and strings (with NUL)
+inline constexpr qsizetype max_key_size{15};
+inline constexpr qsizetype max_string_size{4000};
+
+/// CRC-32 lookup table
+inline constexpr auto crc32_table{[] {
+  std::array<uint32_t, 256u> table{};
+  for (uint32_t i{}; i < table.size(); ++i) {
+    auto c{i};
+    for (auto j{0}; j < 8; ++j) c = c & 1u ? 0xEDB88320u ^ (c >> 1u) : c >> 1u;
+    table[i] = c;
+  }
+  return table;
+}()};
+
+/// CRC-32 as used by NVS
+///
+/// NVS calls esp_rom_crc32_le(0xFFFFFFFF, ...) which inverts the initial value
+/// once more, so the register effectively starts at 0.
+///
+/// \param  data  Data
+/// \param  size  Size of data
+/// \return CRC-32
+uint32_t crc32(char const* data, qsizetype size) {
+  uint32_t crc{};
+  for (qsizetype i{}; i < size; ++i)
+    crc = crc32_table[(crc ^ static_cast<uint8_t>(data[i])) & 0xFFu] ^
+          (crc >> 8u);
+  return ~crc;
+}
+
+/// Writes entries page by page
+class Writer {
+public:
+  /// Ctor
+  ///
+  /// \param  size  Partition size
+  explicit Writer(uint32_t size) : _image(size, '\xFF') {}
+
+  /// Get number of free entries on current page
+  ///
+  /// \return Number of free entries
+  int freeEntries() const { return _page < 0 ? 0 : entries_per_page - _entry; }
+
+  /// Get partition image
+  ///
+  /// \return Partition image
+  QByteArray image() const { return _image; }
+
+  bool nextPage();
+  bool write(uint8_t ns,
+             uint8_t type,
+             QByteArray const& key,
+             QByteArray const& data,
+             QByteArray const& payload = {},
+             uint8_t chunk_index = 0xFFu);
+
+private:
+  char* page() { return _image.data() + _page * page_size; }
+
+  QByteArray _image;
+  qsizetype _page{-1};
+  int _entry{};
+};
+
+/// Mark current page as full and start the next one
+///
+/// \retval true  Page started
+/// \retval false Partition full
+bool Writer::nextPage() {
+  // NVS needs one empty page for garbage collection
+  if (_page + 2 >= _image.size() / page_size) {
+    qCritical() << "NVS partition too small";
+    return false;
+  }
+  if (_page >= 0) qToLittleEndian(page_full, page());
+
+  ++_page;
+  _entry = 0;
+  auto const p{page()};
+  qToLittleEndian(page_active, p);
+  qToLittleEndian(static_cast<uint32_t>(_page), p + 4);
+  p[8] = static_cast<char>(page_version);
+  qToLittleEndian(crc32(p + 4, 24), p + 28);
+  return true;
+}
+
+/// Write entry followed by variable length data
+///
+/// \param  ns          Namespace index
+/// \param  type        Type
+/// \param  key         Key
+/// \param  data        8 byte data field
+/// \param  payload     Variable length data
+/// \param  chunk_index Chunk index of blob data
+/// \retval true        Entry written
+/// \retval false       Partition full
+bool Writer::write(uint8_t ns,
+                   uint8_t type,
+                   QByteArray const& key,
+                   QByteArray const& data,
+                   QByteArray const& payload,
+                   uint8_t chunk_index) {
+  auto const span{
+    static_cast<int>(1 + (payload.size() + entry_size - 1) / entry_size)};
+  if (span > freeEntries() && !nextPage()) return false;
+
+  auto const p{page()};
+  auto const entry{p + first_entry_offset + _entry * entry_size};
+  entry[0] = static_cast<char>(ns);
+  entry[1] = static_cast<char>(type);
+  entry[2] = static_cast<char>(span);
+  entry[3] = static_cast<char>(chunk_index);
+  std::fill_n(entry + 8, 16, '\0');
+  std::copy(key.cbegin(), key.cend(), entry + 8);
+  std::copy_n(data.cbegin(), 8, entry + 24);
+
+  // CRC skips the CRC field itself
+  QByteArray crc_data{entry, 4};
+  crc_data.append(entry + 8, 24);
+  qToLittleEndian(crc32(crc_data.constData(), crc_data.size()), entry + 4);
+  std::copy(payload.cbegin(), payload.cend(), entry + entry_size);
+
+  // Entry state written is 0b10
+  for (auto i{_entry}; i < _entry + span; ++i)
+    p[bitmap_offset + i / 4] &= static_cast<char>(~(1 << (i % 4 * 2)));
+  _entry += span;
+  return true;
+}
+
+/// Create data field of entries followed by variable length data
+///
+/// \param  payload Variable length data
+/// \return Data field
+QByteArray var_data(QByteArray const& payload) {
+  QByteArray data(8, '\xFF');
+  qToLittleEndian(static_cast<uint16_t>(payload.size()), data.data());
+  qToLittleEndian(crc32(payload.constData(), payload.size()), data.data() + 4);
+  return data;
+}
+
+/// Create data field of primitive entries
+///
+/// \tparam T             Type of value
+/// \param  value         Value, decimal or 0x prefixed
+/// \return Data field
+/// \return std::nullopt  Invalid value
+template<typename T>
+std::optional<QByteArray> primitive_data(QByteArray const& value) {
+  auto ok{false};
+  T v{};
+  if constexpr (std::is_signed_v<T>) {
+    auto const i{value.trimmed().toLongLong(&ok, 0)};
+    ok = ok && i >= std::numeric_limits<T>::min() &&
+         i <= std::numeric_limits<T>::max();
+    v = static_cast<T>(i);
+  } else {
+    auto const u{value.trimmed().toULongLong(&ok, 0)};
+    ok = ok && u <= std::numeric_limits<T>::max();
+    v = static_cast<T>(u);
+  }
+  if (!ok) return std::nullopt;
+  QByteArray data(8, '\xFF');
+  qToLittleEndian(v, data.data());
+  return data;
+}
+
+/// Encoding of primitive entries
+struct Primitive {
+  char const* encoding;
+  uint8_t type;
+  std::optional<QByteArray> (*data)(QByteArray const&);
+};
+
+inline constexpr std::array<Primitive, 8u> primitives{{
+  {"u8", U8, primitive_data<uint8_t>},
+  {"i8", I8, primitive_data<int8_t>},
+  {"u16", U16, primitive_data<uint16_t>},
+  {"i16", I16, primitive_data<int16_t>},
+  {"u32", U32, primitive_data<uint32_t>},
+  {"i32", I32, primitive_data<int32_t>},
+  {"u64", U64, primitive_data<uint64_t>},
+  {"i64", I64, primitive_data<int64_t>},
+}};
+
+/// Write blob
+///
+/// Blobs get split into chunks which fill up the remaining entries of a page.
+/// An index entry describing all chunks follows the last one.
+///
+/// \param  writer  Writer
+/// \param  ns      Namespace index
+/// \param  key     Key
+/// \param  blob    Blob
+/// \retval true    Blob written
+/// \retval false   Partition full
+bool write_blob(Writer& writer,
+                uint8_t ns,
+                QByteArray const& key,
+                QByteArray const& blob) {
+  uint8_t chunks{};
+  qsizetype pos{};
+  do {
+    if (writer.freeEntries() < 2 && !writer.nextPage()) return false;
+    auto const chunk{blob.mid(pos, (writer.freeEntries() - 1) * entry_size)};
+    if (!writer.write(ns, BlobData, key, var_data(chunk), chunk, chunks++))
+      return false;
+    pos += chunk.size();
+  } while (pos < blob.size());
+
+  QByteArray data(8, '\xFF');
+  qToLittleEndian(static_cast<uint32_t>(blob.size()), data.data());
+  data[4] = static_cast<char>(chunks);
+  data[5] = '\0';
+  return writer.write(ns, BlobIdx, key, data);
+}
+
+/// Write entry
+///
+/// \param  writer  Writer
+/// \param  ns      Namespace index
+/// \param  entry   Entry
+/// \retval true    Entry written
+/// \retval false   Invalid value or partition full
+bool write_entry(Writer& writer, uint8_t ns, NvsEntry const& entry) {
+  auto const key{entry.key.toUtf8()};
+  auto const& encoding{entry.encoding};
+
+  // Strings
+  if (encoding == "string") {
+    if (auto const payload{entry.value + '\0'};
+        payload.size() <= max_string_size)
+      return writer.write(ns, Sz, key, var_data(payload), payload);
+  }
+  // Blobs
+  else if (encoding == "binary")
+    return write_blob(writer, ns, key, entry.value);
+  else if (encoding == "hex2bin") {
+    if (auto const hex{entry.value.trimmed()};
+        hex.size() % 2 == 0 &&
+        std::all_of(hex.cbegin(), hex.cend(), [](char c) {
+          return std::isxdigit(static_cast<unsigned char>(c));
+        }))
+      return write_blob(writer, ns, key, QByteArray::fromHex(hex));
+  } else if (encoding == "base64") {
+    if (auto const result{QByteArray::fromBase64Encoding(
+          entry.value.trimmed(), QByteArray::AbortOnBase64DecodingErrors)})
+      return write_blob(writer, ns, key, *result);
+  }
+  // Primitives
+  else if (auto const it{std::find_if(primitives.cbegin(),
+                                      primitives.cend(),
+                                      [&encoding](Primitive const& p) {
+                                        return encoding == p.encoding;
+                                      })};
+           it == primitives.cend()) {
+    qCritical().noquote() << "Unknown NVS encoding" << encoding;
+    return false;
+  } else if (auto const data{it->data(entry.value)})
+    return writer.write(ns, it->type, key, *data);
+
+  qCritical().noquote() << "Invalid" << encoding << "value for NVS key"
+                        << entry.key;
+  return false;
+}
+
+} // namespace
+
+/// Create NVS partition image
+///
+/// Creates the same image as the NVS Partition Generator of ESP-IDF does, page
+/// format version 2. Namespaces get an index in order of their first use. The
+/// image is built in memory, no files are involved. See the README for a link
+/// to the generator.
+///
+/// \param  entries Entries
+/// \param  size    Partition size
+/// \return Partition image or empty byte array on error
+QByteArray nvs_partition(QVector<NvsEntry> const& entries, uint32_t size) {
+  if (size % page_size || size < 3u * page_size) {
+    qCritical() << "NVS partition size must be a multiple of 4096 and at "
+                   "least 12288";
+    return {};
+  }
+
+  Writer writer{size};
+  QHash<QString, uint8_t> namespaces;
+  for (auto const& entry : entries) {
+    if (auto const key_size{entry.key.toUtf8().size()};
+        !key_size || key_size > max_key_size) {
+      qCritical().noquote() << "Invalid NVS key" << entry.key;
+      return {};
+    }
+
+    // Namespace entries go first
+    auto ns{namespaces.value(entry.ns)};
+    if (!ns) {
+      auto const ns_key{entry.ns.toUtf8()};
+      if (ns_key.isEmpty() || ns_key.size() > max_key_size ||
+          namespaces.size() >= 254) {
+        qCritical().noquote() << "Invalid NVS namespace" << entry.ns;
+        return {};
+      }
+      ns = static_cast<uint8_t>(namespaces.size() + 1);
+      namespaces.insert(entry.ns, ns);
+      QByteArray data(8, '\xFF');
+      data[0] = static_cast<char>(ns);
+      if (!writer.write(0u, U8, ns_key, data)) return {};
+    }
+
+    if (!write_entry(writer, ns, entry)) return {};
+  }
+
+  return writer.image();
+}
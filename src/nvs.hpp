@@ -0,0 +1,41 @@
+// Copyright (C) 2025 Vincent Hamp
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/// NVS partition image
+///
+/// \file   nvs.hpp
+/// \author Vincent Hamp
+/// \date   19/10/2026
+
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+#include <cstdint>
+
+/// Key-value pair stored in an NVS partition
+///
+/// The encoding is one of u8, i8, u16, i16, u32, i32, u64, i64, string,
+/// hex2bin, base64 or binary, just like in the CSV files of ESP-IDF's
+/// [NVS Partition Generator](https://docs.espressif.com/projects/esp-idf/en/latest/esp32s3/api-reference/storage/nvs_partition_gen.html).
+struct NvsEntry {
+  QString ns{};
+  QString key{};
+  QString encoding{};
+  QByteArray value{};
+};
+
+QByteArray nvs_partition(QVector<NvsEntry> const& entries, uint32_t size);
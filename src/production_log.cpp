@@ -0,0 +1,214 @@
+// Copyright (C) 2025 Vincent Hamp
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/// Persistent production log
+///
+/// \file   production_log.cpp
+/// \author Vincent Hamp
+/// \date   19/10/2026
+
+#include "production_log.hpp"
+#include <QCoreApplication>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <quagzipfile.h>
+#include <utility>
+#include "message_handler.hpp"
+
+namespace {
+
+/// Name of the file currently written to
+inline constexpr auto file_name{"flasher.jsonl"};
+
+/// Records queued beyond this are dropped if the disk can't keep up
+inline constexpr qsizetype max_records{100000};
+
+/// Context of the current thread
+thread_local ProductionLog::Context current_context{};
+
+/// Get name of message type
+///
+/// \param  type  Message type
+/// \return Name of message type
+QString type_name(QtMsgType type) {
+  switch (type) {
+    case QtDebugMsg: return "debug";
+    case QtInfoMsg: return "info";
+    case QtWarningMsg: return "warning";
+    case QtCriticalMsg: return "critical";
+    case QtFatalMsg: return "fatal";
+  }
+  return {};
+}
+
+} // namespace
+
+/// Singleton pattern
+ProductionLog* ProductionLog::get() {
+  static ProductionLog production_log;
+  return &production_log;
+}
+
+/// Get context of records logged from the current thread
+///
+/// \return Context
+ProductionLog::Context ProductionLog::context() { return current_context; }
+
+/// Set context of records logged from the current thread
+///
+/// \param  context Context
+void ProductionLog::setContext(Context context) { current_context = context; }
+
+/// Start writing to directory
+///
+/// \param  path      Directory
+/// \param  max_size  Size in bytes after which the file gets rotated
+/// \retval true      Log opened
+/// \retval false     Error
+bool ProductionLog::open(QString path, qint64 max_size) {
+  if (isRunning()) return false;
+  _dir.setPath(path);
+  _max_size = max_size;
+  if (!_dir.mkpath(".")) {
+    qCritical().noquote() << "Can't create" << path;
+    return false;
+  }
+  connect(MessageHandler::get(),
+          &MessageHandler::messageHandler,
+          this,
+          &ProductionLog::messageHandler,
+          Qt::DirectConnection);
+  connect(qApp, &QCoreApplication::aboutToQuit, this, &ProductionLog::close);
+  start(QThread::LowPriority);
+  return true;
+}
+
+/// Flush remaining records and stop writing
+void ProductionLog::close() {
+  if (!isRunning()) return;
+  disconnect(MessageHandler::get(), nullptr, this, nullptr);
+  {
+    QMutexLocker lock{&_mutex};
+    _quit = true;
+    _cond.wakeOne();
+  }
+  wait();
+}
+
+/// Record outcome of a run
+///
+/// \param  result  Result
+void ProductionLog::result(QString result) {
+  if (!isRunning()) return;
+  append({.time = QDateTime::currentDateTimeUtc(),
+          .type = QtInfoMsg,
+          .context = current_context,
+          .result = result});
+}
+
+/// Record message
+///
+/// \param  type    Message type
+/// \param  context Message context
+/// \param  msg     Message
+void ProductionLog::messageHandler(QtMsgType type,
+                                   QMessageLogContext const&,
+                                   QString const& msg) {
+  append({.time = QDateTime::currentDateTimeUtc(),
+          .type = type,
+          .context = current_context,
+          .msg = msg});
+}
+
+/// Stop writing
+ProductionLog::~ProductionLog() { close(); }
+
+/// Write queued records in the background
+void ProductionLog::run() {
+  QFile file{_dir.filePath(file_name)};
+  QVector<Record> records;
+
+  for (;;) {
+    // Wait for records, but flush at least once a second
+    {
+      QMutexLocker lock{&_mutex};
+      if (_records.isEmpty() && !_quit) _cond.wait(&_mutex, 1000);
+      records = std::exchange(_records, {});
+      if (_dropped) {
+        records.push_back({.time = QDateTime::currentDateTimeUtc(),
+                           .type = QtWarningMsg,
+                           .msg = QString{"Dropped %1 records"}.arg(_dropped)});
+        _dropped = 0;
+      }
+      if (records.isEmpty() && _quit) break;
+    }
+
+    // Count records as dropped if the file can't be opened
+    if (!file.isOpen() &&
+        !file.open(QIODevice::WriteOnly | QIODevice::Append)) {
+      QMutexLocker lock{&_mutex};
+      if (_quit) break;
+      _dropped += records.size();
+      records.clear();
+      continue;
+    }
+
+    for (auto const& record : records) {
+      QJsonObject obj{{"time", record.time.toString(Qt::ISODateWithMs)},
+                      {"level", type_name(record.type)}};
+      if (!record.context.port.isEmpty()) obj["port"] = record.context.port;
+      if (!record.context.mac.isEmpty()) obj["mac"] = record.context.mac;
+      if (!record.context.firmware.isEmpty())
+        obj["firmware"] = record.context.firmware;
+      if (!record.result.isEmpty()) obj["result"] = record.result;
+      if (!record.msg.isEmpty()) obj["msg"] = record.msg;
+      file.write(QJsonDocument{obj}.toJson(QJsonDocument::Compact) + '\n');
+    }
+    records.clear();
+    file.flush();
+
+    if (file.size() >= _max_size) {
+      file.close();
+      rotate();
+    }
+  }
+}
+
+/// Queue record
+///
+/// \param  record  Record
+void ProductionLog::append(Record record) {
+  QMutexLocker lock{&_mutex};
+  if (_records.size() >= max_records) ++_dropped;
+  else _records.push_back(std::move(record));
+  if (_records.size() == 1) _cond.wakeOne();
+}
+
+/// Rename current file and compress it
+void ProductionLog::rotate() {
+  auto const segment_path{_dir.filePath(
+    "flasher-" +
+    QDateTime::currentDateTimeUtc().toString("yyyyMMdd-HHmmss") + ".jsonl")};
+  if (!_dir.rename(file_name, segment_path)) return;
+
+  QFile segment{segment_path};
+  QuaGzipFile gz{segment_path + ".gz"};
+  if (!segment.open(QIODevice::ReadOnly) || !gz.open(QIODevice::WriteOnly))
+    return;
+  while (!segment.atEnd()) gz.write(segment.read(64 * 1024));
+  gz.close();
+  segment.remove();
+}
@@ -0,0 +1,98 @@
+// Copyright (C) 2025 Vincent Hamp
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/// Persistent production log
+///
+/// \file   production_log.hpp
+/// \author Vincent Hamp
+/// \date   19/10/2026
+
+#pragma once
+
+#include <QDateTime>
+#include <QDir>
+#include <QMutex>
+#include <QThread>
+#include <QVector>
+#include <QWaitCondition>
+
+/// Asynchronous file sink for all log messages and per-board results
+///
+/// ProductionLog is a singleton which connects to the MessageHandler next to
+/// Log. Instead of a widget it appends each message as JSON line to a file.
+/// Records only get queued by the calling thread. Formatting, writing,
+/// rotating and compressing happens on a background thread, so logging never
+/// waits for the disk.
+///
+/// Each record carries the context of the thread it was logged from. Workers
+/// set their context (port, board MAC and firmware version) through
+/// ProductionLog::setContext() and report the outcome of a run with
+/// ProductionLog::result().
+///
+/// Once the file exceeds its maximum size it gets renamed and compressed to a
+/// .gz segment.
+class ProductionLog : public QThread {
+  Q_OBJECT
+
+public:
+  /// Context of records logged from the current thread
+  struct Context {
+    QString port{};
+    QString mac{};
+    QString firmware{};
+  };
+
+  static ProductionLog* get();
+  static Context context();
+  static void setContext(Context context);
+
+  bool open(QString path, qint64 max_size = 8 * 1024 * 1024);
+  void close();
+  void result(QString result);
+
+private slots:
+  void messageHandler(QtMsgType type,
+                      QMessageLogContext const& context,
+                      QString const& msg);
+
+private:
+  /// Log record
+  struct Record {
+    QDateTime time{};
+    QtMsgType type{};
+    Context context{};
+    QString result{};
+    QString msg{};
+  };
+
+  ProductionLog() = default;
+  ~ProductionLog();
+  ProductionLog(ProductionLog const&) = delete;
+  ProductionLog(ProductionLog&&) = delete;
+  ProductionLog& operator=(ProductionLog const&) = delete;
+  ProductionLog& operator=(ProductionLog&&) = delete;
+
+  void run() final;
+  void append(Record record);
+  void rotate();
+
+  QDir _dir{};
+  qint64 _max_size{};
+  QMutex _mutex{};
+  QWaitCondition _cond{};
+  QVector<Record> _records{};
+  qsizetype _dropped{};
+  bool _quit{};
+};
@@ -0,0 +1,301 @@
+// Copyright (C) 2025 Vincent Hamp
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/// Per-board provisioning
+///
+/// \file   provisioning.cpp
+/// \author Vincent Hamp
+/// \date   19/10/2026
+
+#include "provisioning.hpp"
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QRegularExpression>
+#include <QSaveFile>
+#include <QTextStream>
+#include <QtEndian>
+#include <algorithm>
+#include "nvs.hpp"
+
+namespace {
+
+/// Partition table entries, only the start of each binary gets searched
+inline constexpr uint32_t partition_table_size{0xC00u};
+inline constexpr qsizetype partition_entry_size{32};
+inline constexpr uint16_t partition_magic{0x50AAu};
+inline constexpr char partition_type_data{0x01};
+inline constexpr char partition_subtype_nvs{0x02};
+
+/// Offset and size of partition
+struct Partition {
+  uint32_t offset{};
+  uint32_t size{};
+};
+
+/// Split line of CSV file
+///
+/// Fields may be enclosed in double quotes, quotes within have to be doubled.
+///
+/// \param  line  Line
+/// \return Fields
+QStringList split_csv(QString const& line) {
+  QStringList fields{QString{}};
+  auto quoted{false};
+  for (qsizetype i{}; i < line.size(); ++i)
+    if (auto const c{line[i]}; quoted) {
+      if (c != '"') fields.back() += c;
+      else if (i + 1 < line.size() && line[i + 1] == '"') {
+        fields.back() += c;
+        ++i;
+      } else quoted = false;
+    } else if (c == '"') quoted = true;
+    else if (c == ',') fields.push_back({});
+    else fields.back() += c;
+  return fields;
+}
+
+/// Read CSV file, empty lines and comments are skipped
+///
+/// \param  path          CSV file path
+/// \return Lines         Fields of all lines
+/// \return std::nullopt  Error
+std::optional<QVector<QStringList>> read_csv(QString path) {
+  QFile file{path};
+  if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+    qCritical().noquote() << "Can't open" << path;
+    return std::nullopt;
+  }
+  QVector<QStringList> lines;
+  QTextStream stream{&file};
+  QString line;
+  while (stream.readLineInto(&line))
+    if (!line.trimmed().isEmpty() && !line.trimmed().startsWith('#'))
+      lines.push_back(split_csv(line));
+  return lines;
+}
+
+/// Find NVS partition in partition table
+///
+/// \param  bins          Binaries
+/// \return Partition     NVS partition
+/// \return std::nullopt  No NVS partition found
+std::optional<Partition> find_nvs_partition(QVector<BinSource> const& bins) {
+  for (auto const& bin : bins) {
+    auto const bytes{bin.read(0u, partition_table_size)};
+    if (!bytes) return std::nullopt;
+    for (qsizetype i{}; i + partition_entry_size <= bytes->size();
+         i += partition_entry_size) {
+      // Table ends with the first entry not starting with magic bytes
+      auto const entry{bytes->constData() + i};
+      if (qFromLittleEndian<uint16_t>(entry) != partition_magic) break;
+      if (entry[2] == partition_type_data && entry[3] == partition_subtype_nvs)
+        return Partition{.offset = qFromLittleEndian<uint32_t>(entry + 4),
+                         .size = qFromLittleEndian<uint32_t>(entry + 8)};
+    }
+  }
+  return std::nullopt;
+}
+
+/// Replace placeholders by columns of record
+///
+/// \param  value         Value containing placeholders like ${serial}
+/// \param  columns       Column names
+/// \param  record        Record
+/// \return Value         Value with placeholders replaced
+/// \return std::nullopt  Unknown column
+std::optional<QString> substitute(QString const& value,
+                                  QStringList const& columns,
+                                  QStringList const& record) {
+  static QRegularExpression const re{R"(\$\{([^}]*)\})"};
+  QString str;
+  qsizetype last{};
+  for (auto it{re.globalMatch(value)}; it.hasNext();) {
+    auto const match{it.next()};
+    auto const column{columns.indexOf(match.captured(1).trimmed())};
+    if (column < 0 || column >= record.size()) {
+      qCritical().noquote() << "Unknown provisioning column"
+                            << match.captured(1);
+      return std::nullopt;
+    }
+    str += value.mid(last, match.capturedStart() - last) + record[column];
+    last = match.capturedEnd();
+  }
+  return str + value.mid(last);
+}
+
+} // namespace
+
+/// Singleton pattern
+Provisioning* Provisioning::get() {
+  static Provisioning provisioning;
+  return &provisioning;
+}
+
+/// Read template and records
+///
+/// \param  template_path Template in NVS Partition Generator CSV format
+/// \param  records_path  CSV file with one record per board, first line
+///                       contains column names (optional)
+/// \retval true          Template and records read
+/// \retval false         Error
+bool Provisioning::open(QString template_path, QString records_path) {
+  auto const lines{read_csv(template_path)};
+  if (!lines) return false;
+
+  _template_dir = QFileInfo{template_path}.absolutePath();
+  _template.clear();
+  for (auto fields : *lines) {
+    // Skip header
+    if (fields.front().trimmed() == "key") continue;
+    while (fields.size() < 4) fields.push_back({});
+    Line const line{.key = fields[0].trimmed(),
+                    .type = fields[1].trimmed(),
+                    .encoding = fields[2].trimmed(),
+                    .value = fields[3]};
+    if ((line.type != "namespace" && line.type != "data" &&
+         line.type != "file") ||
+        (_template.isEmpty() && line.type != "namespace")) {
+      qCritical().noquote() << "Invalid provisioning template line"
+                            << fields.join(',');
+      return false;
+    }
+    _template.push_back(line);
+  }
+
+  _columns.clear();
+  _records.clear();
+  _cursor = 0;
+  if (!records_path.isEmpty()) {
+    auto const records{read_csv(records_path)};
+    if (!records) return false;
+    if (records->isEmpty()) {
+      qCritical().noquote() << "No columns in" << records_path;
+      return false;
+    }
+    for (auto const& column : records->front())
+      _columns.push_back(column.trimmed());
+    _records = records->mid(1);
+
+    // Continue where we left off
+    _cursor_path = records_path + ".cursor";
+    if (QFile file{_cursor_path}; file.open(QIODevice::ReadOnly))
+      _cursor = file.readAll().trimmed().toLongLong();
+    qInfo().noquote() << QString{"%1 of %2 provisioning records left"}
+                           .arg(std::max<qsizetype>(_records.size() - _cursor,
+                                                    0))
+                           .arg(_records.size());
+  }
+
+  _open = true;
+  return true;
+}
+
+/// Check whether a template has been read
+///
+/// \retval true  Template read
+/// \retval false No template read
+bool Provisioning::isOpen() const { return _open; }
+
+/// Get offset of NVS partition
+///
+/// \param  bins          Binaries containing a partition table
+/// \return Offset        Offset of NVS partition
+/// \return std::nullopt  No NVS partition found
+std::optional<uint32_t>
+Provisioning::offset(QVector<BinSource> const& bins) const {
+  if (auto const partition{find_nvs_partition(bins)}) return partition->offset;
+  return std::nullopt;
+}
+
+/// Create NVS partition image for the next board
+///
+/// The record gets consumed as soon as the image has been created, even if
+/// writing it fails later on. A serial number skipped is preferable to one
+/// used twice.
+///
+/// \param  bins          Binaries containing a partition table
+/// \return Bin           NVS partition image at its offset
+/// \return std::nullopt  Error
+std::optional<Bin> Provisioning::next(QVector<BinSource> const& bins) {
+  auto const partition{find_nvs_partition(bins)};
+  if (!partition) {
+    qCritical() << "No NVS partition found";
+    return std::nullopt;
+  }
+
+  QMutexLocker lock{&_mutex};
+  QStringList record;
+  if (!_columns.isEmpty()) {
+    if (_cursor >= _records.size()) {
+      qCritical() << "No provisioning records left";
+      return std::nullopt;
+    }
+    record = _records[_cursor];
+  }
+
+  QVector<NvsEntry> entries;
+  QString ns;
+  for (auto const& line : _template) {
+    auto const value{substitute(line.value, _columns, record)};
+    if (!value) return std::nullopt;
+    else if (line.type == "namespace") {
+      ns = line.key;
+      continue;
+    }
+
+    NvsEntry entry{.ns = ns, .key = line.key, .encoding = line.encoding};
+    if (line.type == "file") {
+      QFile file{QDir{_template_dir}.filePath(*value)};
+      if (!file.open(QIODevice::ReadOnly)) {
+        qCritical().noquote() << "Can't open" << file.fileName();
+        return std::nullopt;
+      }
+      entry.value = file.readAll();
+    } else entry.value = value->toUtf8();
+    entries.push_back(entry);
+  }
+
+  auto const bytes{nvs_partition(entries, partition->size)};
+  if (bytes.isEmpty()) return std::nullopt;
+
+  if (!_columns.isEmpty()) {
+    ++_cursor;
+    if (!saveCursor()) {
+      --_cursor;
+      return std::nullopt;
+    }
+    qInfo().noquote() << QString{"Provisioning record %1 of %2"}
+                           .arg(_cursor)
+                           .arg(_records.size());
+  }
+
+  return Bin{.offset = partition->offset, .bytes = bytes};
+}
+
+/// Store index of next record
+///
+/// \retval true  Cursor stored
+/// \retval false Error
+bool Provisioning::saveCursor() const {
+  QSaveFile file{_cursor_path};
+  if (!file.open(QIODevice::WriteOnly) ||
+      file.write(QByteArray::number(_cursor) + '\n') < 0 || !file.commit()) {
+    qCritical().noquote() << "Can't write" << _cursor_path;
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,82 @@
+// Copyright (C) 2025 Vincent Hamp
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/// Per-board provisioning
+///
+/// \file   provisioning.hpp
+/// \author Vincent Hamp
+/// \date   19/10/2026
+
+#pragma once
+
+#include <QMutex>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <optional>
+#include "bin_source.hpp"
+
+/// Per-board NVS partition images
+///
+/// Provisioning is a singleton which creates an NVS partition image for every
+/// board, e.g. containing serial number, calibration data or default WiFi
+/// settings. The image gets written as additional binary in the same run as
+/// the firmware.
+///
+/// Images are generated from a template in the CSV format of ESP-IDF's
+/// [NVS Partition Generator](https://docs.espressif.com/projects/esp-idf/en/latest/esp32s3/api-reference/storage/nvs_partition_gen.html).
+/// Values of the template may contain placeholders like `${serial}` which get
+/// replaced by the column of the same name of a per-board record. Records are
+/// taken from a CSV file line by line, the next line to use is stored in a
+/// `.cursor` file next to it, so that no record is ever used twice.
+///
+/// Offset and size of the NVS partition are taken from the partition table
+/// contained in the binaries. Provisioning::next() may be called from any
+/// thread.
+class Provisioning {
+public:
+  static Provisioning* get();
+
+  bool open(QString template_path, QString records_path = {});
+  bool isOpen() const;
+  std::optional<uint32_t> offset(QVector<BinSource> const& bins) const;
+  std::optional<Bin> next(QVector<BinSource> const& bins);
+
+private:
+  /// Line of template
+  struct Line {
+    QString key{};
+    QString type{};
+    QString encoding{};
+    QString value{};
+  };
+
+  Provisioning() = default;
+  Provisioning(Provisioning const&) = delete;
+  Provisioning(Provisioning&&) = delete;
+  Provisioning& operator=(Provisioning const&) = delete;
+  Provisioning& operator=(Provisioning&&) = delete;
+
+  bool saveCursor() const;
+
+  QString _template_dir{};
+  QVector<Line> _template{};
+  QStringList _columns{};
+  QVector<QStringList> _records{};
+  QString _cursor_path{};
+  qsizetype _cursor{};
+  bool _open{};
+  QMutex _mutex{};
+};
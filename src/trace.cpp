@@ -0,0 +1,245 @@
+// Copyright (C) 2025 Vincent Hamp
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/// Timing probes and stall watchdog
+///
+/// \file   trace.cpp
+/// \author Vincent Hamp
+/// \date   19/10/2026
+
+#include "trace.hpp"
+#include <QCoreApplication>
+#include <QDebug>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QTimer>
+#include <algorithm>
+#include <utility>
+
+namespace {
+
+/// Events recorded beyond this are dropped
+inline constexpr qsizetype max_events{1000000};
+
+/// Get ID of current thread
+///
+/// \return ID of current thread
+quint64 current_tid() {
+  return static_cast<quint64>(
+    reinterpret_cast<quintptr>(QThread::currentThreadId()));
+}
+
+} // namespace
+
+/// Singleton pattern
+Trace* Trace::get() {
+  static Trace trace;
+  return &trace;
+}
+
+/// Start recording events
+///
+/// Must be called from the main thread. Events get written to the file once
+/// Trace::close() is called, at the latest when the application quits.
+///
+/// \param  path  Trace file
+/// \retval true  Recording
+/// \retval false Error
+bool Trace::open(QString path) {
+  if (_open) return false;
+  if (QFile file{path}; !file.open(QIODevice::WriteOnly)) {
+    qCritical().noquote() << "Can't open" << path;
+    return false;
+  }
+  _path = path;
+  _main_tid = current_tid();
+  connect(qApp, &QCoreApplication::aboutToQuit, this, &Trace::close);
+  _open = true;
+  return true;
+}
+
+/// Stop watchdog and write recorded events
+void Trace::close() {
+  if (isRunning()) {
+    requestInterruption();
+    wait();
+  }
+  if (!_open.exchange(false)) return;
+
+  QJsonArray events;
+  events.append(QJsonObject{{"name", "thread_name"},
+                            {"ph", "M"},
+                            {"pid", 1},
+                            {"tid", static_cast<qint64>(_main_tid)},
+                            {"args", QJsonObject{{"name", "main"}}}});
+  QMutexLocker lock{&_mutex};
+  for (auto const& event : std::as_const(_events)) {
+    QJsonObject obj{{"name", QString::fromUtf8(event.name)},
+                    {"ph", "X"},
+                    {"pid", 1},
+                    {"tid", static_cast<qint64>(event.tid)},
+                    {"ts", event.ts},
+                    {"dur", event.dur}};
+    if (!event.probe.isEmpty())
+      obj["args"] = QJsonObject{{"probe", QString::fromUtf8(event.probe)}};
+    events.append(obj);
+  }
+  if (_dropped)
+    qWarning().noquote() << QString{"Dropped %1 trace events"}.arg(_dropped);
+  _events.clear();
+  lock.unlock();
+
+  QSaveFile file{_path};
+  if (!file.open(QIODevice::WriteOnly) ||
+      file.write(QJsonDocument{QJsonObject{{"traceEvents", events},
+                                           {"displayTimeUnit", "ms"}}}
+                   .toJson(QJsonDocument::Compact)) < 0 ||
+      !file.commit())
+    qCritical().noquote() << "Can't write" << _path;
+}
+
+/// Start watchdog
+///
+/// Must be called from the main thread.
+///
+/// \param  threshold Event loop stalls longer than this get reported [ms]
+void Trace::watch(int threshold) {
+  if (_watching.exchange(true)) return;
+  _threshold = std::max(threshold, 4);
+  _main_tid = current_tid();
+  _heartbeat = now();
+
+  // Heartbeat
+  auto timer{new QTimer{qApp}};
+  connect(timer, &QTimer::timeout, this, [this] { _heartbeat = now(); });
+  timer->start(_threshold / 4);
+
+  connect(qApp, &QCoreApplication::aboutToQuit, this, &Trace::close);
+  start(QThread::HighPriority);
+}
+
+/// Check whether probes are enabled
+///
+/// \retval true  Tracing or watchdog enabled
+/// \retval false Probes disabled
+bool Trace::isEnabled() const {
+  return _open.load(std::memory_order_relaxed) ||
+         _watching.load(std::memory_order_relaxed);
+}
+
+/// Get time since start
+///
+/// \return Time since start [us]
+qint64 Trace::now() const { return _timer.nsecsElapsed() / 1000; }
+
+/// Enter probe
+///
+/// \param  name  Name of probe
+/// \return Probe the main thread was in before, nullptr for other threads
+char const* Trace::enter(char const* name) {
+  return isMainThread() ? _probe.exchange(name) : nullptr;
+}
+
+/// Leave probe and record event
+///
+/// \param  name  Name of probe
+/// \param  outer Probe the main thread was in before
+/// \param  begin Time the probe was entered [us]
+void Trace::leave(char const* name, char const* outer, qint64 begin) {
+  if (isMainThread()) _probe = outer;
+  if (_open.load(std::memory_order_relaxed))
+    append({.name = name,
+            .tid = current_tid(),
+            .ts = begin,
+            .dur = now() - begin});
+}
+
+/// Start timer
+Trace::Trace() { _timer.start(); }
+
+/// Dtor
+Trace::~Trace() { close(); }
+
+/// Watch heartbeat of main thread
+///
+/// Checks happen four times per threshold. A stall begins with the last
+/// heartbeat and ends with the first one after it, minus one timer interval.
+void Trace::run() {
+  auto const interval{_threshold / 4};
+  auto const threshold_us{static_cast<qint64>(_threshold) * 1000};
+  qint64 stall_begin{-1};
+  char const* stall_probe{};
+
+  while (!isInterruptionRequested()) {
+    msleep(static_cast<unsigned long>(interval));
+    auto const heartbeat{_heartbeat.load()};
+
+    // Stalled, remember what the main thread is doing
+    if (now() - heartbeat > threshold_us) {
+      if (stall_begin < 0) {
+        stall_begin = heartbeat;
+        stall_probe = _probe.load();
+      }
+    }
+    // Event loop is running again
+    else if (stall_begin >= 0) {
+      auto const dur{heartbeat - stall_begin - interval * 1000};
+      auto const probe{stall_probe ? stall_probe : "unknown"};
+      qWarning().noquote() << QString{"Event loop stalled for %1ms in %2"}
+                                .arg(dur / 1000)
+                                .arg(QString::fromUtf8(probe));
+      if (_open)
+        append({.name = "Stall",
+                .tid = _main_tid,
+                .ts = stall_begin,
+                .dur = dur,
+                .probe = probe});
+      stall_begin = -1;
+    }
+  }
+}
+
+/// Append event
+///
+/// \param  event Event
+void Trace::append(Event event) {
+  QMutexLocker lock{&_mutex};
+  if (_events.size() >= max_events) ++_dropped;
+  else _events.push_back(std::move(event));
+}
+
+/// Check whether the current thread is the main thread
+///
+/// \retval true  Main thread
+/// \retval false Other thread
+bool Trace::isMainThread() const { return current_tid() == _main_tid; }
+
+/// Enter probe
+///
+/// \param  name  Name of probe, must outlive the probe
+ScopedTrace::ScopedTrace(char const* name) : _name{name} {
+  auto const trace{Trace::get()};
+  if (!trace->isEnabled()) return;
+  _begin = trace->now();
+  _outer = trace->enter(name);
+}
+
+/// Leave probe
+ScopedTrace::~ScopedTrace() {
+  if (_begin < 0) return;
+  Trace::get()->leave(_name, _outer, _begin);
+}
@@ -0,0 +1,108 @@
+// Copyright (C) 2025 Vincent Hamp
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/// Timing probes and stall watchdog
+///
+/// \file   trace.hpp
+/// \author Vincent Hamp
+/// \date   19/10/2026
+
+#pragma once
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QString>
+#include <QThread>
+#include <QVector>
+#include <atomic>
+
+/// Timing probes and event loop stall watchdog
+///
+/// Trace is a singleton which records how long the code covered by ScopedTrace
+/// probes takes. Once opened, events are collected in memory and written in
+/// [Trace Event Format](https://docs.google.com/document/d/1CvAClvFfyA5R-PhYUmn5OOQtYMH4h6I0nSsKchNAySU)
+/// when closed, so that the file can be opened with chrome://tracing or
+/// [Perfetto](https://ui.perfetto.dev).
+///
+/// Trace::watch() starts a watchdog thread. A timer on the main thread keeps
+/// updating a heartbeat. If the heartbeat falls behind by more than the
+/// threshold, the event loop is stalled. The watchdog then notes the innermost
+/// probe the main thread is in, and once the event loop is running again logs
+/// a warning and records a stall event.
+///
+/// Probes are cheap no-ops unless tracing or the watchdog is enabled.
+class Trace : public QThread {
+public:
+  static Trace* get();
+
+  bool open(QString path);
+  void close();
+  void watch(int threshold);
+
+  bool isEnabled() const;
+  qint64 now() const;
+  char const* enter(char const* name);
+  void leave(char const* name, char const* outer, qint64 begin);
+
+private:
+  /// Complete event
+  struct Event {
+    QByteArray name{};
+    quint64 tid{};
+    qint64 ts{};
+    qint64 dur{};
+    QByteArray probe{};
+  };
+
+  Trace();
+  ~Trace();
+  Trace(Trace const&) = delete;
+  Trace(Trace&&) = delete;
+  Trace& operator=(Trace const&) = delete;
+  Trace& operator=(Trace&&) = delete;
+
+  void run() final;
+  void append(Event event);
+  bool isMainThread() const;
+
+  QString _path{};
+  QElapsedTimer _timer{};
+  QMutex _mutex{};
+  QVector<Event> _events{};
+  qsizetype _dropped{};
+  quint64 _main_tid{};
+  int _threshold{};
+  std::atomic<bool> _open{};
+  std::atomic<bool> _watching{};
+  std::atomic<char const*> _probe{};
+  std::atomic<qint64> _heartbeat{};
+};
+
+/// Probe which traces the scope it lives in
+class ScopedTrace {
+public:
+  explicit ScopedTrace(char const* name);
+  ~ScopedTrace();
+  ScopedTrace(ScopedTrace const&) = delete;
+  ScopedTrace(ScopedTrace&&) = delete;
+  ScopedTrace& operator=(ScopedTrace const&) = delete;
+  ScopedTrace& operator=(ScopedTrace&&) = delete;
+
+private:
+  char const* _name{};
+  char const* _outer{};
+  qint64 _begin{-1};
+};
@@ -0,0 +1,407 @@
+// Copyright (C) 2025 Vincent Hamp
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/// Byte streams to targets
+///
+/// \file   transport.cpp
+/// \author Vincent Hamp
+/// \date   19/10/2026
+
+#include "transport.hpp"
+#include <QUrl>
+#include <QtEndian>
+#include <initializer_list>
+
+namespace {
+
+/// Telnet commands and options
+enum Telnet : uint8_t {
+  Binary = 0u,
+  SuppressGoAhead = 3u,
+  ComPortOption = 44u,
+  Se = 240u,
+  Sb = 250u,
+  Will = 251u,
+  Wont = 252u,
+  Do = 253u,
+  Dont = 254u,
+  Iac = 255u,
+};
+
+/// RFC 2217 client commands
+enum ComPort : uint8_t {
+  SetBaudrate = 1u,
+  SetDatasize = 2u,
+  SetParity = 3u,
+  SetStopsize = 4u,
+};
+
+/// Round trips over the network add up, give responses some extra time
+inline constexpr auto network_latency{250};
+
+/// Create byte array from bytes
+///
+/// \param  bytes Bytes
+/// \return Byte array
+QByteArray make_bytes(std::initializer_list<uint8_t> bytes) {
+  QByteArray arr;
+  for (auto const byte : bytes) arr.append(static_cast<char>(byte));
+  return arr;
+}
+
+/// Escape IAC in data sent over Telnet
+///
+/// \param  bytes Data
+/// \return Escaped data
+QByteArray escape_iac(QByteArray bytes) {
+  return bytes.replace("\xFF", "\xFF\xFF");
+}
+
+} // namespace
+
+/// Create transport by name
+///
+/// \param  name  Serial port name, tcp://host:port or rfc2217://host:port
+/// \return Transport
+std::unique_ptr<Transport> Transport::create(QString name) {
+  if (name.startsWith("rfc2217://"))
+    return std::make_unique<Rfc2217Transport>(name);
+  else if (name.startsWith("tcp://"))
+    return std::make_unique<TcpTransport>(name);
+  return std::make_unique<SerialTransport>(name);
+}
+
+/// Check whether name refers to a network transport
+///
+/// \param  name  Name
+/// \retval true  Network transport
+/// \retval false Local serial port
+bool Transport::isNetwork(QString name) {
+  return name.startsWith("rfc2217://") || name.startsWith("tcp://");
+}
+
+/// Ctor
+///
+/// \param  name  Serial port name
+SerialTransport::SerialTransport(QString name) { _port.setPortName(name); }
+
+/// Open serial port with 115200 8N1
+///
+/// \retval true  Opened
+/// \retval false Error
+bool SerialTransport::open() {
+  _port.setBaudRate(QSerialPort::Baud115200);
+  _port.setDataBits(QSerialPort::Data8);
+  _port.setParity(QSerialPort::NoParity);
+  _port.setStopBits(QSerialPort::OneStop);
+  _port.setFlowControl(QSerialPort::NoFlowControl);
+  return _port.open(QIODevice::ReadWrite);
+}
+
+/// Close serial port
+void SerialTransport::close() { _port.close(); }
+
+/// Check whether serial port is open
+///
+/// \retval true  Open
+/// \retval false Closed
+bool SerialTransport::isOpen() const { return _port.isOpen(); }
+
+/// Serial ports support changing the baud rate
+///
+/// \retval true  Always
+bool SerialTransport::supportsBaudRate() const { return true; }
+
+/// Set baud rate
+///
+/// \param  baud_rate Baud rate
+/// \retval true      Baud rate set
+/// \retval false     Error
+bool SerialTransport::setBaudRate(qint32 baud_rate) {
+  return _port.setBaudRate(baud_rate);
+}
+
+/// Get baud rate
+///
+/// \return Baud rate
+qint32 SerialTransport::baudRate() const { return _port.baudRate(); }
+
+/// Write bytes and wait until they are written
+///
+/// \param  bytes Bytes
+/// \retval true  Bytes written
+/// \retval false Error
+bool SerialTransport::write(QByteArray const& bytes) {
+  return _port.write(bytes) == bytes.size() && _port.waitForBytesWritten(3000);
+}
+
+/// Wait for bytes to read
+///
+/// \param  timeout Timeout in ms
+/// \retval true    Bytes available
+/// \retval false   Timeout or error
+bool SerialTransport::waitForReadyRead(int timeout) {
+  return _port.waitForReadyRead(timeout);
+}
+
+/// Read all available bytes
+///
+/// \return Bytes
+QByteArray SerialTransport::readAll() { return _port.readAll(); }
+
+/// Discard buffered bytes
+void SerialTransport::clear() { _port.clear(); }
+
+/// Get name of serial port
+///
+/// \return Name of serial port
+QString SerialTransport::name() const { return _port.portName(); }
+
+/// Get description of last error
+///
+/// \return Description of last error
+QString SerialTransport::errorString() const { return _port.errorString(); }
+
+/// Ctor
+///
+/// \param  name  tcp://host:port
+TcpTransport::TcpTransport(QString name) : _name{name} {}
+
+/// Connect to serial port server
+///
+/// \retval true  Connected
+/// \retval false Error
+bool TcpTransport::open() {
+  QUrl const url{_name};
+  if (url.host().isEmpty() || url.port() < 0) {
+    _error_string = "Invalid address " + _name;
+    return false;
+  }
+  _socket.connectToHost(url.host(), static_cast<quint16>(url.port()));
+  if (!_socket.waitForConnected(3000)) {
+    _error_string = _socket.errorString();
+    return false;
+  }
+  // Packets are small and each one waits for a response, don't delay them
+  _socket.setSocketOption(QAbstractSocket::LowDelayOption, 1);
+  _socket.setSocketOption(QAbstractSocket::KeepAliveOption, 1);
+  return true;
+}
+
+/// Disconnect
+void TcpTransport::close() { _socket.abort(); }
+
+/// Check whether connection is established
+///
+/// \retval true  Connected
+/// \retval false Disconnected
+bool TcpTransport::isOpen() const {
+  return _socket.state() == QAbstractSocket::ConnectedState;
+}
+
+/// Raw TCP servers run at a fixed baud rate
+///
+/// \retval false Always
+bool TcpTransport::supportsBaudRate() const { return false; }
+
+/// Set baud rate
+///
+/// \param  baud_rate Baud rate
+/// \retval true      Baud rate unchanged
+/// \retval false     Baud rate can't be changed
+bool TcpTransport::setBaudRate(qint32 baud_rate) {
+  if (baud_rate == _baud_rate) return true;
+  _error_string = "Can't change baud rate of " + _name;
+  return false;
+}
+
+/// Get baud rate
+///
+/// \return Baud rate
+qint32 TcpTransport::baudRate() const { return _baud_rate; }
+
+/// Write bytes and wait until they are written
+///
+/// \param  bytes Bytes
+/// \retval true  Bytes written
+/// \retval false Error
+bool TcpTransport::write(QByteArray const& bytes) { return writeRaw(bytes); }
+
+/// Wait for bytes to read
+///
+/// \param  timeout Timeout in ms
+/// \retval true    Bytes available
+/// \retval false   Timeout or error
+bool TcpTransport::waitForReadyRead(int timeout) {
+  return _socket.bytesAvailable() || _socket.waitForReadyRead(timeout);
+}
+
+/// Read all available bytes
+///
+/// \return Bytes
+QByteArray TcpTransport::readAll() { return _socket.readAll(); }
+
+/// Discard received bytes
+void TcpTransport::clear() { _socket.readAll(); }
+
+/// Get name
+///
+/// \return tcp://host:port
+QString TcpTransport::name() const { return _name; }
+
+/// Get description of last error
+///
+/// \return Description of last error
+QString TcpTransport::errorString() const { return _error_string; }
+
+/// Get additional time responses may take to arrive
+///
+/// \return Latency in ms
+int TcpTransport::latency() const { return network_latency; }
+
+/// Write bytes as they are and wait until they are written
+///
+/// \param  bytes Bytes
+/// \retval true  Bytes written
+/// \retval false Error
+bool TcpTransport::writeRaw(QByteArray const& bytes) {
+  if (_socket.write(bytes) != bytes.size() ||
+      !_socket.waitForBytesWritten(3000 + network_latency)) {
+    _error_string = _socket.errorString();
+    return false;
+  }
+  return true;
+}
+
+/// Ctor
+///
+/// \param  name  rfc2217://host:port
+Rfc2217Transport::Rfc2217Transport(QString name) : TcpTransport{name} {}
+
+/// Connect to serial port server and configure port as 115200 8N1
+///
+/// \retval true  Connected
+/// \retval false Error
+bool Rfc2217Transport::open() {
+  _state = State::Data;
+  if (!TcpTransport::open()) return false;
+  return writeRaw(make_bytes({Iac,
+                              Will,
+                              Binary,
+                              Iac,
+                              Do,
+                              Binary,
+                              Iac,
+                              Will,
+                              SuppressGoAhead,
+                              Iac,
+                              Do,
+                              SuppressGoAhead,
+                              Iac,
+                              Will,
+                              ComPortOption})) &&
+         subnegotiate(SetDatasize, make_bytes({8u})) &&
+         subnegotiate(SetParity, make_bytes({1u})) &&
+         subnegotiate(SetStopsize, make_bytes({1u})) &&
+         setBaudRate(QSerialPort::Baud115200);
+}
+
+/// RFC 2217 supports changing the baud rate
+///
+/// \retval true  Always
+bool Rfc2217Transport::supportsBaudRate() const { return true; }
+
+/// Set baud rate of remote serial port
+///
+/// \param  baud_rate Baud rate
+/// \retval true      Baud rate set
+/// \retval false     Error
+bool Rfc2217Transport::setBaudRate(qint32 baud_rate) {
+  QByteArray value(4, '\0');
+  qToBigEndian(static_cast<uint32_t>(baud_rate), value.data());
+  if (!subnegotiate(SetBaudrate, value)) return false;
+  _baud_rate = baud_rate;
+  return true;
+}
+
+/// Write bytes and wait until they are written
+///
+/// \param  bytes Bytes
+/// \retval true  Bytes written
+/// \retval false Error
+bool Rfc2217Transport::write(QByteArray const& bytes) {
+  return writeRaw(escape_iac(bytes));
+}
+
+/// Read all available bytes
+///
+/// Telnet commands get stripped. Options the server offers or asks for which
+/// haven't been negotiated are refused.
+///
+/// \return Bytes
+QByteArray Rfc2217Transport::readAll() {
+  QByteArray bytes;
+  QByteArray reply;
+  for (auto const c : TcpTransport::readAll())
+    switch (auto const byte{static_cast<uint8_t>(c)}; _state) {
+      case State::Data:
+        if (byte == Iac) _state = State::Iac;
+        else bytes.append(c);
+        break;
+      case State::Iac:
+        if (byte == Iac) {
+          bytes.append(c);
+          _state = State::Data;
+        } else if (byte == Sb) _state = State::Sub;
+        else if (byte >= Will && byte <= Dont) {
+          _verb = byte;
+          _state = State::Option;
+        } else _state = State::Data;
+        break;
+      case State::Option:
+        if (byte != Binary && byte != SuppressGoAhead &&
+            byte != ComPortOption) {
+          if (_verb == Do) reply.append(make_bytes({Iac, Wont, byte}));
+          else if (_verb == Will) reply.append(make_bytes({Iac, Dont, byte}));
+        }
+        _state = State::Data;
+        break;
+      case State::Sub:
+        if (byte == Iac) _state = State::SubIac;
+        break;
+      case State::SubIac:
+        _state = byte == Se ? State::Data : State::Sub;
+        break;
+    }
+  if (!reply.isEmpty()) writeRaw(reply);
+  return bytes;
+}
+
+/// Discard received bytes
+///
+/// The bytes still go through the Telnet parser, so that commands split
+/// across reads don't end up in the data read next.
+void Rfc2217Transport::clear() { readAll(); }
+
+/// Send COM port control command
+///
+/// \param  cmd   Command
+/// \param  value Value
+/// \retval true  Command sent
+/// \retval false Error
+bool Rfc2217Transport::subnegotiate(uint8_t cmd, QByteArray const& value) {
+  return writeRaw(make_bytes({Iac, Sb, ComPortOption, cmd}) +
+                  escape_iac(value) + make_bytes({Iac, Se}));
+}
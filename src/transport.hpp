@@ -0,0 +1,138 @@
+// Copyright (C) 2025 Vincent Hamp
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/// Byte streams to targets
+///
+/// \file   transport.hpp
+/// \author Vincent Hamp
+/// \date   19/10/2026
+
+#pragma once
+
+#include <QByteArray>
+#include <QSerialPort>
+#include <QString>
+#include <QTcpSocket>
+#include <memory>
+
+/// Byte stream to a target
+///
+/// Transport hides whether Loader talks to a local serial port or to a serial
+/// port shared over the network. Transport::create() picks the implementation
+/// by the port name:
+/// - `tcp://host:port` raw TCP, e.g. ser2net in raw mode
+/// - `rfc2217://host:port` Telnet with
+///   [RFC 2217](https://datatracker.ietf.org/doc/html/rfc2217) COM port
+///   control, which allows changing the baud rate
+/// - anything else is a local serial port
+///
+/// All calls block and must be made from the thread which opened the
+/// transport.
+class Transport {
+public:
+  virtual ~Transport() = default;
+
+  static std::unique_ptr<Transport> create(QString name);
+  static bool isNetwork(QString name);
+
+  virtual bool open() = 0;
+  virtual void close() = 0;
+  virtual bool isOpen() const = 0;
+  virtual bool supportsBaudRate() const = 0;
+  virtual bool setBaudRate(qint32 baud_rate) = 0;
+  virtual qint32 baudRate() const = 0;
+  virtual bool write(QByteArray const& bytes) = 0;
+  virtual bool waitForReadyRead(int timeout) = 0;
+  virtual QByteArray readAll() = 0;
+  virtual void clear() = 0;
+  virtual QString name() const = 0;
+  virtual QString errorString() const = 0;
+
+  /// Get additional time responses may take to arrive
+  ///
+  /// \return Latency in ms
+  virtual int latency() const { return 0; }
+};
+
+/// Local serial port
+class SerialTransport : public Transport {
+public:
+  explicit SerialTransport(QString name);
+
+  bool open() override;
+  void close() override;
+  bool isOpen() const override;
+  bool supportsBaudRate() const override;
+  bool setBaudRate(qint32 baud_rate) override;
+  qint32 baudRate() const override;
+  bool write(QByteArray const& bytes) override;
+  bool waitForReadyRead(int timeout) override;
+  QByteArray readAll() override;
+  void clear() override;
+  QString name() const override;
+  QString errorString() const override;
+
+private:
+  QSerialPort _port{};
+};
+
+/// Raw TCP connection to a serial port server
+class TcpTransport : public Transport {
+public:
+  explicit TcpTransport(QString name);
+
+  bool open() override;
+  void close() override;
+  bool isOpen() const override;
+  bool supportsBaudRate() const override;
+  bool setBaudRate(qint32 baud_rate) override;
+  qint32 baudRate() const override;
+  bool write(QByteArray const& bytes) override;
+  bool waitForReadyRead(int timeout) override;
+  QByteArray readAll() override;
+  void clear() override;
+  QString name() const override;
+  QString errorString() const override;
+  int latency() const override;
+
+protected:
+  bool writeRaw(QByteArray const& bytes);
+
+  QString _name{};
+  QTcpSocket _socket{};
+  QString _error_string{};
+  qint32 _baud_rate{QSerialPort::Baud115200};
+};
+
+/// Telnet connection with RFC 2217 COM port control
+class Rfc2217Transport : public TcpTransport {
+public:
+  explicit Rfc2217Transport(QString name);
+
+  bool open() override;
+  bool supportsBaudRate() const override;
+  bool setBaudRate(qint32 baud_rate) override;
+  bool write(QByteArray const& bytes) override;
+  QByteArray readAll() override;
+  void clear() override;
+
+private:
+  bool subnegotiate(uint8_t cmd, QByteArray const& value);
+
+  /// State of Telnet parser
+  enum class State : uint8_t { Data, Iac, Option, Sub, SubIac };
+  State _state{};
+  uint8_t _verb{};
+};
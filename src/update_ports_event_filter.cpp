@@ -22,6 +22,8 @@
 #include "update_ports_event_filter.hpp"
 #include <QMouseEvent>
 #include <esp_flasher/available_ports.hpp>
+#include "trace.hpp"
+#include "transport.hpp"
 
 UpdatePortsEventFilter::UpdatePortsEventFilter(QWidget* parent)
   : QObject{parent} {}
@@ -29,6 +31,7 @@ UpdatePortsEventFilter::UpdatePortsEventFilter(QWidget* parent)
 bool UpdatePortsEventFilter::eventFilter(QObject* obj, QEvent* event) {
   if (event->type() == QEvent::MouseButtonPress &&
       static_cast<QMouseEvent*>(event)->button() == Qt::LeftButton) {
+    ScopedTrace const trace{"UpdatePortsEventFilter::eventFilter"};
     QComboBox* port_combobox{static_cast<QComboBox*>(obj)};
 
     // Backup current port
@@ -40,9 +43,14 @@ bool UpdatePortsEventFilter::eventFilter(QObject* obj, QEvent* event) {
       port_combobox->addItem(port_info.portName());
     port_combobox->addItem("auto");
 
-    // Try to find backed up port
-    auto const current_index{port_combobox->findText(current_port)};
-    if (current_index != -1) port_combobox->setCurrentIndex(current_index);
+    // Try to find backed up port, network ports aren't listed so keep them
+    if (auto const current_index{port_combobox->findText(current_port)};
+        current_index != -1)
+      port_combobox->setCurrentIndex(current_index);
+    else if (Transport::isNetwork(current_port)) {
+      port_combobox->addItem(current_port);
+      port_combobox->setCurrentIndex(port_combobox->count() - 1);
+    }
   }
   // Standard event processing
   return QObject::eventFilter(obj, event);
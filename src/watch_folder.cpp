@@ -0,0 +1,113 @@
+// Copyright (C) 2025 Vincent Hamp
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/// Watch folder for firmware archives
+///
+/// \file   watch_folder.cpp
+/// \author Vincent Hamp
+/// \date   19/10/2026
+
+#include "watch_folder.hpp"
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <quazip.h>
+#include "archive.hpp"
+
+namespace {
+
+/// Interval between scans if the file system watcher misses something
+inline constexpr auto poll_interval{2000};
+
+} // namespace
+
+/// Start watching folder
+///
+/// \param  path    Folder
+/// \param  parent  Parent
+WatchFolder::WatchFolder(QString path, QObject* parent)
+  : QObject{parent}, _path{path} {
+  _watcher.addPath(path);
+  connect(&_watcher,
+          &QFileSystemWatcher::directoryChanged,
+          this,
+          &WatchFolder::scan);
+  connect(&_watcher,
+          &QFileSystemWatcher::fileChanged,
+          this,
+          &WatchFolder::scan);
+  connect(&_timer, &QTimer::timeout, this, &WatchFolder::scan);
+  _timer.start(poll_interval);
+  _pool.setMaxThreadCount(1);
+  scan();
+}
+
+/// Wait for archive being read
+///
+/// Results queued afterwards get discarded along with the object.
+WatchFolder::~WatchFolder() { _pool.waitForDone(); }
+
+/// Scan folder for complete archives and ingest the newest one
+void WatchFolder::scan() {
+  QHash<QString, File> files;
+  QFileInfo newest;
+  for (auto const& info : QDir{_path}.entryInfoList(
+         {"*.zip"}, QDir::Files | QDir::Readable, QDir::Time)) {
+    auto const path{info.absoluteFilePath()};
+    auto const prev{_files.value(path)};
+    File const file{.size = info.size(),
+                    .last_modified = info.lastModified(),
+                    .stable = prev.size == info.size() &&
+                              prev.last_modified == info.lastModified()};
+    files.insert(path, file);
+
+    // Watch archives themselves too, some writers don't touch the folder
+    if (!_watcher.files().contains(path)) _watcher.addPath(path);
+
+    // Sorted by time, so the first stable one is the newest
+    if (file.stable && !newest.exists()) newest = info;
+  }
+  _files = files;
+
+  if (_busy || !newest.exists() ||
+      (_ingested.isValid() && newest.lastModified() <= _ingested))
+    return;
+
+  // Half-written archives lack the central directory at the end
+  if (QuaZip zip{newest.absoluteFilePath()}; !zip.open(QuaZip::mdUnzip))
+    return;
+
+  _ingested = newest.lastModified();
+  ingest(newest.absoluteFilePath());
+}
+
+/// Read archive in the background
+///
+/// \param  path  Archive
+void WatchFolder::ingest(QString path) {
+  _busy = true;
+  _pool.start([this, path] {
+    auto const bins{read_archive(path)};
+    QMetaObject::invokeMethod(this, [this, path, bins] {
+      _busy = false;
+      if (bins.isEmpty()) return;
+      qInfo().noquote() << "Loaded" << QFileInfo{path}.fileName()
+                        << firmware_version(bins);
+      emit binaries(bins);
+      // Something newer might have arrived in the meantime
+      scan();
+    });
+  });
+}
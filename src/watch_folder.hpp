@@ -0,0 +1,75 @@
+// Copyright (C) 2025 Vincent Hamp
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+/// Watch folder for firmware archives
+///
+/// \file   watch_folder.hpp
+/// \author Vincent Hamp
+/// \date   19/10/2026
+
+#pragma once
+
+#include <QDateTime>
+#include <QFileSystemWatcher>
+#include <QHash>
+#include <QObject>
+#include <QThreadPool>
+#include <QTimer>
+#include "bin_source.hpp"
+
+/// Watches a folder for new firmware archives
+///
+/// WatchFolder notices new or changed .zip files in a folder, either through
+/// a [QFileSystemWatcher](https://doc.qt.io/qt-6/qfilesystemwatcher.html) or,
+/// where that isn't available, by polling. The newest archive gets read on a
+/// [QThreadPool](https://doc.qt.io/qt-6/qthreadpool.html) of its own and its
+/// binaries are emitted once they are ready, so the main thread never waits
+/// for an archive to be read. The binaries themselves only get inflated while
+/// writing, see BinSource.
+///
+/// Archives still being copied are skipped. A file counts as complete once
+/// its size and modification time haven't changed between two scans and it
+/// can be opened as zip archive.
+class WatchFolder : public QObject {
+  Q_OBJECT
+
+public:
+  explicit WatchFolder(QString path, QObject* parent = nullptr);
+  ~WatchFolder();
+
+signals:
+  void binaries(QVector<BinSource> bins);
+
+private slots:
+  void scan();
+
+private:
+  /// State of a file between scans
+  struct File {
+    qint64 size{};
+    QDateTime last_modified{};
+    bool stable{};
+  };
+
+  void ingest(QString path);
+
+  QString _path{};
+  QFileSystemWatcher _watcher{};
+  QTimer _timer{};
+  QHash<QString, File> _files{};
+  QDateTime _ingested{};
+  QThreadPool _pool{};
+  bool _busy{};
+};